@@ -0,0 +1,245 @@
+#pragma once
+
+#include "dijkstra_router.h"
+#include "graph.h"
+#include "parallel.h"
+#include "router.h"
+#include "search_workspace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+    // ALT engine: A* search guided by landmarks and the triangle inequality. The constructor stores the
+    // weights from every landmark to every vertex and back, O(K * V) memory for K landmarks. For a
+    // landmark L, d(v, to) >= d(v, L) - d(to, L) and d(v, to) >= d(L, to) - d(L, v), and the best of these
+    // bounds steers the search towards `to`. Landmarks far out on the edge of the network give the
+    // tightest bounds; more of them means tighter bounds for more memory.
+    template <typename Weight>
+    class AltRouter : public RouterBase<Weight> {
+    private:
+        using Graph = DirectedWeightedGraph<Weight>;
+
+    public:
+        using RouteInfo = typename RouterBase<Weight>::RouteInfo;
+
+        static constexpr size_t DEFAULT_LANDMARK_COUNT = 16;
+
+        // Landmark distances are computed by 2 * K searches spread over `thread_count` workers
+        // (0 means one per hardware thread)
+        AltRouter(const Graph& graph, std::vector<VertexId> landmarks, size_t thread_count = 1);
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+        // No single goal to steer to: one plain Dijkstra for all targets
+        std::vector<std::optional<Weight>> GetRouteWeights(VertexId from,
+            const std::vector<VertexId>& targets) const override;
+
+        const std::vector<VertexId>& GetLandmarks() const {
+            return landmarks_;
+        }
+
+        // Bytes held by the landmark tables
+        size_t GetMemoryUsage() const {
+            return (to_landmarks_.capacity() + from_landmarks_.capacity()) * sizeof(Weight)
+                + (to_landmarks_reached_.capacity() + from_landmarks_reached_.capacity()) * sizeof(uint8_t);
+        }
+
+    private:
+        // Search state plus the potential (lower bound to the goal) of every vertex it met
+        struct Workspace {
+            explicit Workspace(size_t vertex_count)
+                : search(vertex_count)
+                , potentials(vertex_count)
+                , potential_stamps(vertex_count, 0) {
+            }
+
+            detail::SearchState<Weight> search;
+            std::vector<std::optional<Weight>> potentials;
+            std::vector<uint32_t> potential_stamps;
+        };
+
+        size_t GetCellIndex(VertexId vertex, size_t landmark) const {
+            return vertex * landmarks_.size() + landmark;
+        }
+
+        // Lower bound on the weight from `vertex` to `to`, nullopt when `vertex` can't reach `to`
+        std::optional<Weight> ComputeLowerBound(VertexId vertex, VertexId to) const;
+
+        static constexpr Weight ZERO_WEIGHT{};
+        const Graph& graph_;
+        std::vector<VertexId> landmarks_;
+        // Vertex-major K-wide rows, so a bound reads two contiguous rows. A flag of 0 means unreachable.
+        std::vector<Weight> to_landmarks_;
+        std::vector<Weight> from_landmarks_;
+        std::vector<uint8_t> to_landmarks_reached_;
+        std::vector<uint8_t> from_landmarks_reached_;
+        detail::WorkspacePool<Workspace> workspaces_;
+    };
+
+    template <typename Weight>
+    AltRouter<Weight>::AltRouter(const Graph& graph, std::vector<VertexId> landmarks, size_t thread_count)
+        : graph_(graph)
+        , landmarks_(std::move(landmarks))
+    {
+        detail::CheckRoutableGraph(graph);
+        const size_t vertex_count = graph.GetVertexCount();
+        for (const VertexId landmark : landmarks_) {
+            if (landmark >= vertex_count) {
+                throw std::out_of_range("Vertex id is out of range");
+            }
+        }
+
+        const size_t landmark_count = landmarks_.size();
+        to_landmarks_.assign(vertex_count * landmark_count, ZERO_WEIGHT);
+        from_landmarks_.assign(vertex_count * landmark_count, ZERO_WEIGHT);
+        to_landmarks_reached_.assign(vertex_count * landmark_count, 0);
+        from_landmarks_reached_.assign(vertex_count * landmark_count, 0);
+
+        // Task 2k searches forward from landmark k, task 2k + 1 backward to it
+        const ReverseAdjacency<Weight> reverse_adjacency(graph);
+        detail::WorkspacePool<detail::SearchState<Weight>> states;
+        parallel::ForEachIndex(2 * landmark_count, thread_count, [&](size_t task) {
+            const size_t landmark = task / 2;
+            const bool is_forward = task % 2 == 0;
+            const auto holder = states.Acquire(vertex_count);
+            detail::SearchState<Weight>& state = *holder;
+            if (is_forward) {
+                detail::ComputeAllWeightsFrom([&](VertexId vertex) { return graph.GetAdjacency(vertex); },
+                    state, landmarks_[landmark]);
+            }
+            else {
+                detail::ComputeAllWeightsFrom([&](VertexId vertex) { return reverse_adjacency.GetAdjacency(vertex); },
+                    state, landmarks_[landmark]);
+            }
+
+            std::vector<Weight>& weights = is_forward ? from_landmarks_ : to_landmarks_;
+            std::vector<uint8_t>& reached = is_forward ? from_landmarks_reached_ : to_landmarks_reached_;
+            for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+                if (state.IsReached(vertex)) {
+                    weights[GetCellIndex(vertex, landmark)] = state.weights[vertex];
+                    reached[GetCellIndex(vertex, landmark)] = 1;
+                }
+            }
+        });
+    }
+
+    template <typename Weight>
+    std::optional<Weight> AltRouter<Weight>::ComputeLowerBound(VertexId vertex, VertexId to) const {
+        Weight bound = ZERO_WEIGHT;
+        const size_t vertex_row = GetCellIndex(vertex, 0);
+        const size_t to_row = GetCellIndex(to, 0);
+        for (size_t landmark = 0; landmark < landmarks_.size(); ++landmark) {
+            // d(vertex, L) <= d(vertex, to) + d(to, L)
+            if (to_landmarks_reached_[to_row + landmark]) {
+                if (!to_landmarks_reached_[vertex_row + landmark]) {
+                    return std::nullopt;
+                }
+                const Weight vertex_to_landmark = to_landmarks_[vertex_row + landmark];
+                const Weight to_to_landmark = to_landmarks_[to_row + landmark];
+                if (to_to_landmark < vertex_to_landmark) {
+                    bound = std::max(bound, vertex_to_landmark - to_to_landmark);
+                }
+            }
+            // d(L, to) <= d(L, vertex) + d(vertex, to)
+            if (from_landmarks_reached_[vertex_row + landmark]) {
+                if (!from_landmarks_reached_[to_row + landmark]) {
+                    return std::nullopt;
+                }
+                const Weight landmark_to_vertex = from_landmarks_[vertex_row + landmark];
+                const Weight landmark_to_to = from_landmarks_[to_row + landmark];
+                if (landmark_to_vertex < landmark_to_to) {
+                    bound = std::max(bound, landmark_to_to - landmark_to_vertex);
+                }
+            }
+        }
+        return bound;
+    }
+
+    // Queue keys are weight + potential. The bounds are consistent, so `to` is final when popped;
+    // vertices that provably can't reach `to` are never queued.
+    template <typename Weight>
+    std::optional<typename AltRouter<Weight>::RouteInfo> AltRouter<Weight>::BuildRoute(VertexId from, VertexId to) const {
+        const size_t vertex_count = graph_.GetVertexCount();
+        if (from >= vertex_count || to >= vertex_count) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+
+        const auto holder = workspaces_.Acquire(vertex_count);
+        Workspace& workspace = *holder;
+        detail::SearchState<Weight>& state = workspace.search;
+        state.Start();
+        if (state.stamp == 1) {
+            std::fill(workspace.potential_stamps.begin(), workspace.potential_stamps.end(), 0);
+        }
+        const auto get_potential = [&](VertexId vertex) -> const std::optional<Weight>& {
+            if (workspace.potential_stamps[vertex] != state.stamp) {
+                workspace.potential_stamps[vertex] = state.stamp;
+                workspace.potentials[vertex] = ComputeLowerBound(vertex, to);
+            }
+            return workspace.potentials[vertex];
+        };
+
+        const std::optional<Weight>& from_potential = get_potential(from);
+        if (!from_potential) {
+            return std::nullopt;
+        }
+        state.Reach(from, ZERO_WEIGHT, std::nullopt);
+        state.Push(*from_potential, from);
+
+        bool is_found = false;
+        while (!state.IsQueueEmpty()) {
+            const auto [key, vertex] = state.Pop();
+            const Weight weight = state.weights[vertex];
+            if (key > weight + *workspace.potentials[vertex]) {
+                continue;
+            }
+            if (vertex == to) {
+                is_found = true;
+                break;
+            }
+
+            const AdjacencySpan<Weight> adjacency = graph_.GetAdjacency(vertex);
+            for (size_t i = 0; i < adjacency.size; ++i) {
+                const VertexId target = adjacency.targets[i];
+                const Weight candidate_weight = weight + adjacency.weights[i];
+                if (state.IsReached(target) && !(candidate_weight < state.weights[target])) {
+                    continue;
+                }
+                const std::optional<Weight>& potential = get_potential(target);
+                if (potential) {
+                    state.Reach(target, candidate_weight, adjacency.edge_ids[i]);
+                    state.Push(candidate_weight + *potential, target);
+                }
+            }
+        }
+
+        if (!is_found) {
+            return std::nullopt;
+        }
+
+        std::vector<EdgeId> edges;
+        for (std::optional<EdgeId> edge_id = state.prev_edges[to];
+            edge_id;
+            edge_id = state.prev_edges[graph_.GetEdge(*edge_id).from])
+        {
+            edges.push_back(*edge_id);
+        }
+        std::reverse(edges.begin(), edges.end());
+
+        return RouteInfo{ state.weights[to], std::move(edges) };
+    }
+
+    template <typename Weight>
+    std::vector<std::optional<Weight>> AltRouter<Weight>::GetRouteWeights(VertexId from,
+        const std::vector<VertexId>& targets) const {
+        const auto holder = workspaces_.Acquire(graph_.GetVertexCount());
+        return detail::ComputeWeightsFrom(graph_, holder->search, from, targets);
+    }
+
+}  // namespace graph
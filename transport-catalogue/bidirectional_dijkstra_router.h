@@ -0,0 +1,176 @@
+#pragma once
+
+#include "dijkstra_router.h"
+#include "graph.h"
+#include "router.h"
+#include "search_workspace.h"
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+    // On-demand engine like DijkstraRouter, but a query grows two searches: forward from `from` over
+    // the graph and backward from `to` over its reversed copy, until they can't improve the best
+    // meeting found so far. Each search covers roughly a ball of half the route's radius.
+    template <typename Weight>
+    class BidirectionalDijkstraRouter : public RouterBase<Weight> {
+    private:
+        using Graph = DirectedWeightedGraph<Weight>;
+
+    public:
+        using RouteInfo = typename RouterBase<Weight>::RouteInfo;
+
+        explicit BidirectionalDijkstraRouter(const Graph& graph);
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+        // One-to-many gains nothing from the backward search: a single forward search for all targets
+        std::vector<std::optional<Weight>> GetRouteWeights(VertexId from,
+            const std::vector<VertexId>& targets) const override;
+
+    private:
+        struct Workspace {
+            explicit Workspace(size_t vertex_count)
+                : forward(vertex_count)
+                , backward(vertex_count) {
+            }
+
+            detail::SearchState<Weight> forward;
+            detail::SearchState<Weight> backward;
+        };
+
+        // Settles one vertex of a direction; `get_adjacency` gives the edges leaving a vertex in the
+        // direction of the search. The opposite queue must not be empty.
+        template <typename GetAdjacency>
+        static void SearchStep(GetAdjacency get_adjacency, detail::SearchState<Weight>& state,
+            const detail::SearchState<Weight>& opposite_state, std::optional<Weight>& best_weight,
+            VertexId& meeting_vertex);
+
+        static constexpr Weight ZERO_WEIGHT{};
+        const Graph& graph_;
+        const ReverseAdjacency<Weight> reverse_adjacency_;
+        detail::WorkspacePool<Workspace> workspaces_;
+    };
+
+    template <typename Weight>
+    BidirectionalDijkstraRouter<Weight>::BidirectionalDijkstraRouter(const Graph& graph)
+        : graph_(graph)
+        , reverse_adjacency_(graph)
+    {
+        detail::CheckRoutableGraph(graph);
+    }
+
+    // Every meeting is checked when a label is set. A vertex isn't queued when its label plus the top
+    // of the opposite queue, a lower bound on the rest of any route through it that isn't found yet,
+    // can't beat the best meeting: on an optimal route the first vertex not settled yet by either search
+    // always stays queued, so the route is still found.
+    template <typename Weight>
+    template <typename GetAdjacency>
+    void BidirectionalDijkstraRouter<Weight>::SearchStep(GetAdjacency get_adjacency,
+        detail::SearchState<Weight>& state, const detail::SearchState<Weight>& opposite_state,
+        std::optional<Weight>& best_weight, VertexId& meeting_vertex) {
+        const auto [weight, vertex] = state.Pop();
+        if (weight > state.weights[vertex]) {
+            return;
+        }
+
+        const Weight opposite_top = opposite_state.GetQueueTopWeight();
+        const AdjacencySpan<Weight> adjacency = get_adjacency(vertex);
+        for (size_t i = 0; i < adjacency.size; ++i) {
+            const VertexId target = adjacency.targets[i];
+            const Weight candidate_weight = weight + adjacency.weights[i];
+            if (state.IsReached(target) && !(candidate_weight < state.weights[target])) {
+                continue;
+            }
+            state.Reach(target, candidate_weight, adjacency.edge_ids[i]);
+
+            if (opposite_state.IsReached(target)) {
+                const Weight meeting_weight = candidate_weight + opposite_state.weights[target];
+                if (!best_weight || meeting_weight < *best_weight) {
+                    best_weight = meeting_weight;
+                    meeting_vertex = target;
+                }
+            }
+            if (!best_weight || candidate_weight + opposite_top < *best_weight) {
+                state.Push(candidate_weight, target);
+            }
+        }
+    }
+
+    template <typename Weight>
+    std::optional<typename BidirectionalDijkstraRouter<Weight>::RouteInfo> BidirectionalDijkstraRouter<Weight>::BuildRoute(
+        VertexId from, VertexId to) const {
+        const size_t vertex_count = graph_.GetVertexCount();
+        if (from >= vertex_count || to >= vertex_count) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+
+        const auto holder = workspaces_.Acquire(vertex_count);
+        auto& forward = holder->forward;
+        auto& backward = holder->backward;
+        forward.Start();
+        backward.Start();
+
+        forward.Reach(from, ZERO_WEIGHT, std::nullopt);
+        forward.Push(ZERO_WEIGHT, from);
+        backward.Reach(to, ZERO_WEIGHT, std::nullopt);
+        backward.Push(ZERO_WEIGHT, to);
+
+        std::optional<Weight> best_weight;
+        VertexId meeting_vertex = from;
+        if (from == to) {
+            best_weight = ZERO_WEIGHT;
+        }
+
+        const auto get_forward_adjacency = [this](VertexId vertex) {
+            return graph_.GetAdjacency(vertex);
+        };
+        const auto get_backward_adjacency = [this](VertexId vertex) {
+            return reverse_adjacency_.GetAdjacency(vertex);
+        };
+
+        // Once either search runs out, every vertex it could reach is final and every meeting is seen
+        while (!forward.IsQueueEmpty() && !backward.IsQueueEmpty()
+            && (!best_weight || forward.GetQueueTopWeight() + backward.GetQueueTopWeight() < *best_weight)) {
+            if (!(backward.GetQueueTopWeight() < forward.GetQueueTopWeight())) {
+                SearchStep(get_forward_adjacency, forward, backward, best_weight, meeting_vertex);
+            }
+            else {
+                SearchStep(get_backward_adjacency, backward, forward, best_weight, meeting_vertex);
+            }
+        }
+
+        if (!best_weight) {
+            return std::nullopt;
+        }
+
+        std::vector<EdgeId> edges;
+        for (std::optional<EdgeId> edge_id = forward.prev_edges[meeting_vertex];
+            edge_id;
+            edge_id = forward.prev_edges[graph_.GetEdge(*edge_id).from])
+        {
+            edges.push_back(*edge_id);
+        }
+        std::reverse(edges.begin(), edges.end());
+        for (std::optional<EdgeId> edge_id = backward.prev_edges[meeting_vertex];
+            edge_id;
+            edge_id = backward.prev_edges[graph_.GetEdge(*edge_id).to])
+        {
+            edges.push_back(*edge_id);
+        }
+
+        return RouteInfo{ *best_weight, std::move(edges) };
+    }
+
+    template <typename Weight>
+    std::vector<std::optional<Weight>> BidirectionalDijkstraRouter<Weight>::GetRouteWeights(VertexId from,
+        const std::vector<VertexId>& targets) const {
+        const auto holder = workspaces_.Acquire(graph_.GetVertexCount());
+        return detail::ComputeWeightsFrom(graph_, holder->forward, from, targets);
+    }
+
+}  // namespace graph
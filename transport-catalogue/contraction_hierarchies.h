@@ -0,0 +1,559 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "search_workspace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+    // Contraction Hierarchies engine. The constructor contracts vertices one by one in order of
+    // importance, adding shortcut edges that preserve shortest distances among the remaining ones.
+    // A query is a bidirectional search that only climbs the hierarchy, and shortcuts found on the
+    // way are unpacked back into the original edges of the graph. Query-side data is indexed by rank
+    // rather than by vertex id, so the top of the hierarchy, which every query climbs to, stays
+    // in a few cache lines.
+    template <typename Weight>
+    class ContractionHierarchiesRouter : public RouterBase<Weight> {
+    private:
+        using Graph = DirectedWeightedGraph<Weight>;
+
+    public:
+        using RouteInfo = typename RouterBase<Weight>::RouteInfo;
+
+        explicit ContractionHierarchiesRouter(const Graph& graph);
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+        // One upward search from `from` shared by all targets, then a backward search per target;
+        // weights are read off the meeting points, no shortcut is unpacked
+        std::vector<std::optional<Weight>> GetRouteWeights(VertexId from,
+            const std::vector<VertexId>& targets) const override;
+
+        size_t GetShortcutCount() const {
+            return shortcut_count_;
+        }
+
+    private:
+        static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+
+        using Rank = uint32_t;
+        using HierarchyEdgeId = uint32_t;
+        static constexpr HierarchyEdgeId NO_HIERARCHY_EDGE = std::numeric_limits<HierarchyEdgeId>::max();
+
+        // Original edge when `second_child == NO_EDGE`, otherwise a shortcut over two hierarchy edges
+        struct HierarchyEdge {
+            VertexId from;
+            VertexId to;
+            Weight weight;
+            EdgeId first_child;
+            EdgeId second_child;
+        };
+
+        struct UpwardEdge {
+            Rank to;
+            HierarchyEdgeId hierarchy_edge;
+            Weight weight;
+        };
+
+        // Edges leaving rank r are [offsets[r], offsets[r + 1])
+        struct UpwardGraph {
+            std::vector<size_t> offsets;
+            std::vector<UpwardEdge> edges;
+        };
+
+        // One direction of a query. A label is valid only while its stamp is the search's,
+        // so a reset costs O(1); weight, stamp and predecessor share a cache line
+        struct SearchDirection {
+            struct Label {
+                Weight weight;
+                uint32_t stamp;
+                HierarchyEdgeId prev_edge;
+            };
+
+            explicit SearchDirection(size_t vertex_count)
+                : labels(vertex_count, Label{ ZERO_WEIGHT, 0, NO_HIERARCHY_EDGE }) {
+            }
+
+            void Start(Rank rank) {
+                if (++stamp == 0) {
+                    for (Label& label : labels) {
+                        label.stamp = 0;
+                    }
+                    stamp = 1;
+                }
+                queue.Clear();
+                Reach(rank, ZERO_WEIGHT, NO_HIERARCHY_EDGE);
+            }
+
+            bool IsReached(Rank rank) const {
+                return labels[rank].stamp == stamp;
+            }
+
+            void Reach(Rank rank, Weight weight, HierarchyEdgeId prev_edge) {
+                labels[rank] = Label{ weight, stamp, prev_edge };
+                queue.Push(weight, rank);
+            }
+
+            std::vector<Label> labels;
+            detail::SearchQueue<Weight, Rank> queue;
+            uint32_t stamp = 0;
+        };
+
+        struct Workspace {
+            explicit Workspace(size_t vertex_count)
+                : forward(vertex_count)
+                , backward(vertex_count) {
+            }
+
+            SearchDirection forward;
+            SearchDirection backward;
+        };
+
+        struct Meeting {
+            Weight weight;
+            Rank rank;
+        };
+
+        class Contractor;
+
+        UpwardGraph BuildUpwardGraph(bool is_forward) const;
+
+        static void SearchStep(const UpwardGraph& upward_graph, const UpwardGraph& opposite_graph,
+            SearchDirection& direction, const SearchDirection& opposite_direction, std::optional<Meeting>& meeting);
+
+        // Runs both upward searches; the meeting point is where the shortest route peaks
+        std::optional<Meeting> Search(Workspace& workspace, VertexId from, VertexId to) const;
+
+        void UnpackEdge(EdgeId hierarchy_edge, std::vector<EdgeId>& edges) const;
+
+        static constexpr Weight ZERO_WEIGHT{};
+        size_t vertex_count_ = 0;
+        size_t shortcut_count_ = 0;
+        std::vector<HierarchyEdge> hierarchy_edges_;
+        std::vector<Rank> ranks_;
+        UpwardGraph forward_graph_;
+        UpwardGraph backward_graph_;
+        detail::WorkspacePool<Workspace> workspaces_;
+    };
+
+    // Preprocessing state, dropped once the hierarchy is built
+    template <typename Weight>
+    class ContractionHierarchiesRouter<Weight>::Contractor {
+    public:
+        Contractor(const Graph& graph, std::vector<HierarchyEdge>& hierarchy_edges)
+            : hierarchy_edges_(hierarchy_edges)
+            , out_edges_(graph.GetVertexCount())
+            , in_edges_(graph.GetVertexCount())
+            , is_contracted_(graph.GetVertexCount(), false)
+            , contracted_neighbors_(graph.GetVertexCount(), 0)
+            , levels_(graph.GetVertexCount(), 0)
+            , witness_search_(graph.GetVertexCount())
+            , target_stamps_(graph.GetVertexCount(), 0) {
+            detail::CheckRoutableGraph(graph);
+            for (VertexId vertex = 0; vertex < graph.GetVertexCount(); ++vertex) {
+                const AdjacencySpan<Weight> adjacency = graph.GetAdjacency(vertex);
+                for (size_t i = 0; i < adjacency.size; ++i) {
+                    if (adjacency.targets[i] != vertex) {
+                        AddEdge({ vertex, adjacency.targets[i], adjacency.weights[i], adjacency.edge_ids[i], NO_EDGE });
+                    }
+                }
+            }
+        }
+
+        // Returns the rank of every vertex in the contraction order
+        std::vector<Rank> Contract() {
+            const size_t vertex_count = out_edges_.size();
+            using QueueItem = std::pair<int, VertexId>;
+            std::vector<QueueItem> queue;
+            queue.reserve(vertex_count);
+            for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+                queue.push_back({ ComputePriority(vertex), vertex });
+            }
+            std::make_heap(queue.begin(), queue.end(), std::greater<QueueItem>{});
+
+            std::vector<Rank> ranks(vertex_count);
+            Rank next_rank = 0;
+            while (!queue.empty()) {
+                std::pop_heap(queue.begin(), queue.end(), std::greater<QueueItem>{});
+                const VertexId vertex = queue.back().second;
+                queue.pop_back();
+
+                // Lazy update: priorities of the neighbours drift as the graph shrinks
+                const int priority = ComputePriority(vertex);
+                if (!queue.empty() && priority > queue.front().first) {
+                    queue.push_back({ priority, vertex });
+                    std::push_heap(queue.begin(), queue.end(), std::greater<QueueItem>{});
+                    continue;
+                }
+
+                ContractVertex(vertex);
+                ranks[vertex] = next_rank++;
+            }
+            return ranks;
+        }
+
+    private:
+        // Settled-vertex limits of a witness search; when hit, a possibly redundant shortcut is added.
+        // Priority estimation only needs the shortcut count, so it runs much shorter searches
+        static constexpr size_t SIMULATION_SETTLE_LIMIT = 20;
+        static constexpr size_t CONTRACTION_SETTLE_LIMIT = 200;
+
+        struct Shortcut {
+            VertexId from;
+            VertexId to;
+            Weight weight;
+            EdgeId in_edge;
+            EdgeId out_edge;
+        };
+
+        void AddEdge(const HierarchyEdge& edge) {
+            hierarchy_edges_.push_back(edge);
+            const EdgeId id = hierarchy_edges_.size() - 1;
+            out_edges_[edge.from].push_back(id);
+            in_edges_[edge.to].push_back(id);
+        }
+
+        // Shortcuts needed to contract `vertex`: one per in/out pair of neighbours
+        // that has no witness path avoiding `vertex`
+        std::vector<Shortcut> FindShortcuts(VertexId vertex, size_t settle_limit) {
+            std::vector<Shortcut> shortcuts;
+            Weight max_out_weight = ZERO_WEIGHT;
+            for (const EdgeId out_edge : out_edges_[vertex]) {
+                max_out_weight = std::max(max_out_weight, hierarchy_edges_[out_edge].weight);
+            }
+
+            ++target_stamp_;
+            size_t target_count = 0;
+            for (const EdgeId out_edge : out_edges_[vertex]) {
+                const VertexId target = hierarchy_edges_[out_edge].to;
+                if (target_stamps_[target] != target_stamp_) {
+                    target_stamps_[target] = target_stamp_;
+                    ++target_count;
+                }
+            }
+
+            for (const EdgeId in_edge : in_edges_[vertex]) {
+                const VertexId source = hierarchy_edges_[in_edge].from;
+                const Weight in_weight = hierarchy_edges_[in_edge].weight;
+                RunWitnessSearch(source, vertex, in_weight + max_out_weight, target_count, settle_limit);
+
+                for (const EdgeId out_edge : out_edges_[vertex]) {
+                    const VertexId target = hierarchy_edges_[out_edge].to;
+                    if (target == source) {
+                        continue;
+                    }
+                    const Weight shortcut_weight = in_weight + hierarchy_edges_[out_edge].weight;
+                    if (witness_search_.IsReached(target) && !(shortcut_weight < witness_search_.weights[target])) {
+                        continue;
+                    }
+                    shortcuts.push_back({ source, target, shortcut_weight, in_edge, out_edge });
+                }
+            }
+            return shortcuts;
+        }
+
+        // Dijkstra from `source` over the uncontracted graph without `excluded`, bounded by `max_weight`;
+        // stops early once all `target_count` stamped targets are settled
+        void RunWitnessSearch(VertexId source, VertexId excluded, Weight max_weight, size_t target_count,
+            size_t settle_limit) {
+            witness_search_.Start();
+            witness_search_.Reach(source, ZERO_WEIGHT, std::nullopt);
+            witness_search_.Push(ZERO_WEIGHT, source);
+
+            size_t settled_count = 0;
+            while (!witness_search_.IsQueueEmpty() && settled_count < settle_limit) {
+                const auto [weight, vertex] = witness_search_.Pop();
+                if (weight > witness_search_.weights[vertex]) {
+                    continue;
+                }
+                if (max_weight < weight) {
+                    break;
+                }
+                if (target_stamps_[vertex] == target_stamp_ && --target_count == 0) {
+                    break;
+                }
+                ++settled_count;
+
+                for (const EdgeId edge_id : out_edges_[vertex]) {
+                    const auto& edge = hierarchy_edges_[edge_id];
+                    if (edge.to == excluded || is_contracted_[edge.to]) {
+                        continue;
+                    }
+                    const Weight candidate_weight = weight + edge.weight;
+                    if (max_weight < candidate_weight) {
+                        continue;
+                    }
+                    if (!witness_search_.IsReached(edge.to) || candidate_weight < witness_search_.weights[edge.to]) {
+                        witness_search_.Reach(edge.to, candidate_weight, edge_id);
+                        witness_search_.Push(candidate_weight, edge.to);
+                    }
+                }
+            }
+        }
+
+        int ComputePriority(VertexId vertex) {
+            const int edge_difference = static_cast<int>(FindShortcuts(vertex, SIMULATION_SETTLE_LIMIT).size())
+                - static_cast<int>(in_edges_[vertex].size() + out_edges_[vertex].size());
+            // Bus lines make the graph dense, so spreading contractions out (contracted neighbours)
+            // keeps the upward graph sparser than favouring the edge difference does
+            return edge_difference + static_cast<int>(2 * contracted_neighbors_[vertex] + levels_[vertex]);
+        }
+
+        void ContractVertex(VertexId vertex) {
+            for (const Shortcut& shortcut : FindShortcuts(vertex, CONTRACTION_SETTLE_LIMIT)) {
+                AddEdge({ shortcut.from, shortcut.to, shortcut.weight, shortcut.in_edge, shortcut.out_edge });
+            }
+            is_contracted_[vertex] = true;
+
+            // Edges to the contracted vertex stay in `hierarchy_edges_`, only the adjacency forgets them
+            const auto touches_vertex = [this, vertex](EdgeId edge_id) {
+                const auto& edge = hierarchy_edges_[edge_id];
+                return edge.from == vertex || edge.to == vertex;
+            };
+            for (const EdgeId in_edge : in_edges_[vertex]) {
+                auto& neighbor_edges = out_edges_[hierarchy_edges_[in_edge].from];
+                neighbor_edges.erase(std::remove_if(neighbor_edges.begin(), neighbor_edges.end(), touches_vertex), neighbor_edges.end());
+                ++contracted_neighbors_[hierarchy_edges_[in_edge].from];
+                levels_[hierarchy_edges_[in_edge].from] = std::max(levels_[hierarchy_edges_[in_edge].from], levels_[vertex] + 1);
+            }
+            for (const EdgeId out_edge : out_edges_[vertex]) {
+                auto& neighbor_edges = in_edges_[hierarchy_edges_[out_edge].to];
+                neighbor_edges.erase(std::remove_if(neighbor_edges.begin(), neighbor_edges.end(), touches_vertex), neighbor_edges.end());
+                ++contracted_neighbors_[hierarchy_edges_[out_edge].to];
+                levels_[hierarchy_edges_[out_edge].to] = std::max(levels_[hierarchy_edges_[out_edge].to], levels_[vertex] + 1);
+            }
+            out_edges_[vertex].clear();
+            out_edges_[vertex].shrink_to_fit();
+            in_edges_[vertex].clear();
+            in_edges_[vertex].shrink_to_fit();
+        }
+
+        std::vector<HierarchyEdge>& hierarchy_edges_;
+        std::vector<std::vector<EdgeId>> out_edges_;
+        std::vector<std::vector<EdgeId>> in_edges_;
+        std::vector<bool> is_contracted_;
+        std::vector<size_t> contracted_neighbors_;
+        std::vector<size_t> levels_;
+        detail::SearchState<Weight> witness_search_;
+        std::vector<size_t> target_stamps_;
+        size_t target_stamp_ = 0;
+    };
+
+    template <typename Weight>
+    ContractionHierarchiesRouter<Weight>::ContractionHierarchiesRouter(const Graph& graph)
+        : vertex_count_(graph.GetVertexCount())
+    {
+        if (vertex_count_ >= std::numeric_limits<Rank>::max()) {
+            throw std::length_error("Graph is too large for contraction hierarchies");
+        }
+        {
+            Contractor contractor(graph, hierarchy_edges_);
+            ranks_ = contractor.Contract();
+        }
+        if (hierarchy_edges_.size() >= NO_HIERARCHY_EDGE) {
+            throw std::length_error("Too many shortcuts for contraction hierarchies");
+        }
+        hierarchy_edges_.shrink_to_fit();
+        for (const HierarchyEdge& edge : hierarchy_edges_) {
+            if (edge.second_child != NO_EDGE) {
+                ++shortcut_count_;
+            }
+        }
+
+        forward_graph_ = BuildUpwardGraph(true);
+        backward_graph_ = BuildUpwardGraph(false);
+    }
+
+    // Forward graph keeps edges leading to higher ranks; backward graph keeps reversed edges
+    // leading from higher ranks, so that both searches only go up
+    template <typename Weight>
+    typename ContractionHierarchiesRouter<Weight>::UpwardGraph ContractionHierarchiesRouter<Weight>::BuildUpwardGraph(
+        bool is_forward) const {
+        UpwardGraph upward_graph;
+        upward_graph.offsets.assign(vertex_count_ + 1, 0);
+
+        const auto get_endpoints = [this, is_forward](const HierarchyEdge& edge) {
+            return is_forward ? std::pair{ ranks_[edge.from], ranks_[edge.to] } : std::pair{ ranks_[edge.to], ranks_[edge.from] };
+        };
+
+        for (const HierarchyEdge& edge : hierarchy_edges_) {
+            const auto [tail, head] = get_endpoints(edge);
+            if (tail < head) {
+                ++upward_graph.offsets[tail + 1];
+            }
+        }
+        for (size_t rank = 0; rank < vertex_count_; ++rank) {
+            upward_graph.offsets[rank + 1] += upward_graph.offsets[rank];
+        }
+
+        upward_graph.edges.resize(upward_graph.offsets.back());
+        std::vector<size_t> positions(upward_graph.offsets.begin(), upward_graph.offsets.end() - 1);
+        for (EdgeId edge_id = 0; edge_id < hierarchy_edges_.size(); ++edge_id) {
+            const auto [tail, head] = get_endpoints(hierarchy_edges_[edge_id]);
+            if (tail < head) {
+                upward_graph.edges[positions[tail]++] = UpwardEdge{ head, static_cast<HierarchyEdgeId>(edge_id),
+                    hierarchy_edges_[edge_id].weight };
+            }
+        }
+        return upward_graph;
+    }
+
+    // Settles one vertex of a direction. Stall-on-demand: a vertex that is reached cheaper through
+    // a higher-ranked neighbour (an edge of the opposite upward graph) is not expanded further
+    template <typename Weight>
+    void ContractionHierarchiesRouter<Weight>::SearchStep(const UpwardGraph& upward_graph,
+        const UpwardGraph& opposite_graph, SearchDirection& direction, const SearchDirection& opposite_direction,
+        std::optional<Meeting>& meeting) {
+        const auto [weight, rank] = direction.queue.Pop();
+        if (weight > direction.labels[rank].weight) {
+            return;
+        }
+        if (opposite_direction.IsReached(rank)) {
+            const Weight candidate_weight = weight + opposite_direction.labels[rank].weight;
+            if (!meeting || candidate_weight < meeting->weight) {
+                meeting = Meeting{ candidate_weight, rank };
+            }
+        }
+
+        for (size_t i = opposite_graph.offsets[rank]; i < opposite_graph.offsets[rank + 1]; ++i) {
+            const UpwardEdge& edge = opposite_graph.edges[i];
+            if (direction.IsReached(edge.to) && direction.labels[edge.to].weight + edge.weight < weight) {
+                return;
+            }
+        }
+
+        for (size_t i = upward_graph.offsets[rank]; i < upward_graph.offsets[rank + 1]; ++i) {
+            const UpwardEdge& edge = upward_graph.edges[i];
+            const Weight candidate_weight = weight + edge.weight;
+            if (!direction.IsReached(edge.to) || candidate_weight < direction.labels[edge.to].weight) {
+                direction.Reach(edge.to, candidate_weight, edge.hierarchy_edge);
+            }
+        }
+    }
+
+    template <typename Weight>
+    std::optional<typename ContractionHierarchiesRouter<Weight>::Meeting> ContractionHierarchiesRouter<Weight>::Search(
+        Workspace& workspace, VertexId from, VertexId to) const {
+        if (from >= vertex_count_ || to >= vertex_count_) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+
+        SearchDirection& forward = workspace.forward;
+        SearchDirection& backward = workspace.backward;
+        forward.Start(ranks_[from]);
+        backward.Start(ranks_[to]);
+
+        std::optional<Meeting> meeting;
+        const auto is_direction_done = [&meeting](const SearchDirection& direction) {
+            return direction.queue.IsEmpty() || (meeting && !(direction.queue.GetTopKey() < meeting->weight));
+        };
+
+        while (!is_direction_done(forward) || !is_direction_done(backward)) {
+            if (!is_direction_done(forward)) {
+                SearchStep(forward_graph_, backward_graph_, forward, backward, meeting);
+            }
+            if (!is_direction_done(backward)) {
+                SearchStep(backward_graph_, forward_graph_, backward, forward, meeting);
+            }
+        }
+        return meeting;
+    }
+
+    template <typename Weight>
+    std::optional<typename ContractionHierarchiesRouter<Weight>::RouteInfo> ContractionHierarchiesRouter<Weight>::BuildRoute(
+        VertexId from, VertexId to) const {
+        const auto holder = workspaces_.Acquire(vertex_count_);
+        const std::optional<Meeting> meeting = Search(*holder, from, to);
+        if (!meeting) {
+            return std::nullopt;
+        }
+
+        const SearchDirection& forward = holder->forward;
+        const SearchDirection& backward = holder->backward;
+        std::vector<EdgeId> forward_path;
+        for (HierarchyEdgeId edge_id = forward.labels[meeting->rank].prev_edge;
+            edge_id != NO_HIERARCHY_EDGE;
+            edge_id = forward.labels[ranks_[hierarchy_edges_[edge_id].from]].prev_edge)
+        {
+            forward_path.push_back(edge_id);
+        }
+        std::reverse(forward_path.begin(), forward_path.end());
+        for (HierarchyEdgeId edge_id = backward.labels[meeting->rank].prev_edge;
+            edge_id != NO_HIERARCHY_EDGE;
+            edge_id = backward.labels[ranks_[hierarchy_edges_[edge_id].to]].prev_edge)
+        {
+            forward_path.push_back(edge_id);
+        }
+
+        std::vector<EdgeId> edges;
+        for (const EdgeId hierarchy_edge : forward_path) {
+            UnpackEdge(hierarchy_edge, edges);
+        }
+
+        return RouteInfo{ meeting->weight, std::move(edges) };
+    }
+
+    template <typename Weight>
+    std::vector<std::optional<Weight>> ContractionHierarchiesRouter<Weight>::GetRouteWeights(VertexId from,
+        const std::vector<VertexId>& targets) const {
+        if (from >= vertex_count_) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        for (const VertexId to : targets) {
+            if (to >= vertex_count_) {
+                throw std::out_of_range("Vertex id is out of range");
+            }
+        }
+
+        const auto holder = workspaces_.Acquire(vertex_count_);
+        SearchDirection& forward = holder->forward;
+        SearchDirection& backward = holder->backward;
+
+        // The backward direction still holds labels of an earlier query here, so meetings
+        // found while exhausting the forward search are dropped
+        forward.Start(ranks_[from]);
+        std::optional<Meeting> dropped_meeting;
+        while (!forward.queue.IsEmpty()) {
+            SearchStep(forward_graph_, backward_graph_, forward, backward, dropped_meeting);
+        }
+
+        std::vector<std::optional<Weight>> weights;
+        weights.reserve(targets.size());
+        for (const VertexId to : targets) {
+            // The forward labels are final, so the backward search can stop at the best meeting
+            backward.Start(ranks_[to]);
+            std::optional<Meeting> meeting;
+            while (!backward.queue.IsEmpty() && (!meeting || backward.queue.GetTopKey() < meeting->weight)) {
+                SearchStep(backward_graph_, forward_graph_, backward, forward, meeting);
+            }
+            weights.push_back(meeting ? std::optional<Weight>(meeting->weight) : std::nullopt);
+        }
+        return weights;
+    }
+
+    template <typename Weight>
+    void ContractionHierarchiesRouter<Weight>::UnpackEdge(EdgeId hierarchy_edge, std::vector<EdgeId>& edges) const {
+        std::vector<EdgeId> stack{ hierarchy_edge };
+        while (!stack.empty()) {
+            const HierarchyEdge& edge = hierarchy_edges_[stack.back()];
+            stack.pop_back();
+            if (edge.second_child == NO_EDGE) {
+                edges.push_back(edge.first_child);
+            }
+            else {
+                stack.push_back(edge.second_child);
+                stack.push_back(edge.first_child);
+            }
+        }
+    }
+
+}  // namespace graph
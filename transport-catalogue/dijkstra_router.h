@@ -0,0 +1,226 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "search_workspace.h"
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+    namespace detail {
+
+        // Full single-source Dijkstra from `from`; `get_adjacency` gives the edges leaving a vertex
+        // in the direction of the search, so the same code runs over reversed adjacency
+        template <typename Weight, typename GetAdjacency>
+        void ComputeAllWeightsFrom(GetAdjacency get_adjacency, SearchState<Weight>& state, VertexId from) {
+            state.Start();
+            state.Reach(from, Weight{}, std::nullopt);
+            state.Push(Weight{}, from);
+            while (!state.IsQueueEmpty()) {
+                const auto [weight, vertex] = state.Pop();
+                if (weight > state.weights[vertex]) {
+                    continue;
+                }
+                const AdjacencySpan<Weight> adjacency = get_adjacency(vertex);
+                for (size_t i = 0; i < adjacency.size; ++i) {
+                    const VertexId target = adjacency.targets[i];
+                    const Weight candidate_weight = weight + adjacency.weights[i];
+                    if (!state.IsReached(target) || candidate_weight < state.weights[target]) {
+                        state.Reach(target, candidate_weight, adjacency.edge_ids[i]);
+                        state.Push(candidate_weight, target);
+                    }
+                }
+            }
+        }
+
+        // Single-source Dijkstra from `from` that stops once every vertex of `targets` is settled.
+        // Returns their weights in the order of `targets`, nullopt for unreachable ones.
+        template <typename Weight>
+        std::vector<std::optional<Weight>> ComputeWeightsFrom(const DirectedWeightedGraph<Weight>& graph,
+            SearchState<Weight>& state, VertexId from, const std::vector<VertexId>& targets) {
+            const size_t vertex_count = graph.GetVertexCount();
+            if (from >= vertex_count) {
+                throw std::out_of_range("Vertex id is out of range");
+            }
+            std::vector<bool> is_target(vertex_count, false);
+            size_t remaining_targets = 0;
+            for (const VertexId to : targets) {
+                if (to >= vertex_count) {
+                    throw std::out_of_range("Vertex id is out of range");
+                }
+                if (!is_target[to]) {
+                    is_target[to] = true;
+                    ++remaining_targets;
+                }
+            }
+
+            state.Start();
+            state.Reach(from, Weight{}, std::nullopt);
+            state.Push(Weight{}, from);
+            while (remaining_targets > 0 && !state.IsQueueEmpty()) {
+                const auto [weight, vertex] = state.Pop();
+                if (weight > state.weights[vertex]) {
+                    continue;
+                }
+                if (is_target[vertex]) {
+                    is_target[vertex] = false;
+                    --remaining_targets;
+                }
+
+                const AdjacencySpan<Weight> adjacency = graph.GetAdjacency(vertex);
+                for (size_t i = 0; i < adjacency.size; ++i) {
+                    const VertexId target = adjacency.targets[i];
+                    const Weight candidate_weight = weight + adjacency.weights[i];
+                    if (!state.IsReached(target) || candidate_weight < state.weights[target]) {
+                        state.Reach(target, candidate_weight, adjacency.edge_ids[i]);
+                        state.Push(candidate_weight, target);
+                    }
+                }
+            }
+
+            std::vector<std::optional<Weight>> weights;
+            weights.reserve(targets.size());
+            for (const VertexId to : targets) {
+                weights.push_back(state.IsReached(to) ? std::optional<Weight>(state.weights[to]) : std::nullopt);
+            }
+            return weights;
+        }
+
+        // Single-source Dijkstra from `from` that stops at the first vertex heavier than `max_weight`.
+        // Returns the settled vertices with their weights, in order of weight.
+        template <typename Weight>
+        std::vector<std::pair<VertexId, Weight>> ComputeWeightsWithin(const DirectedWeightedGraph<Weight>& graph,
+            SearchState<Weight>& state, VertexId from, Weight max_weight) {
+            if (from >= graph.GetVertexCount()) {
+                throw std::out_of_range("Vertex id is out of range");
+            }
+
+            std::vector<std::pair<VertexId, Weight>> settled;
+            state.Start();
+            state.Reach(from, Weight{}, std::nullopt);
+            state.Push(Weight{}, from);
+            while (!state.IsQueueEmpty()) {
+                const auto [weight, vertex] = state.Pop();
+                if (weight > state.weights[vertex]) {
+                    continue;
+                }
+                if (weight > max_weight) {
+                    break;
+                }
+                settled.push_back({ vertex, weight });
+
+                const AdjacencySpan<Weight> adjacency = graph.GetAdjacency(vertex);
+                for (size_t i = 0; i < adjacency.size; ++i) {
+                    const VertexId target = adjacency.targets[i];
+                    const Weight candidate_weight = weight + adjacency.weights[i];
+                    if (!(candidate_weight > max_weight)
+                        && (!state.IsReached(target) || candidate_weight < state.weights[target])) {
+                        state.Reach(target, candidate_weight, adjacency.edge_ids[i]);
+                        state.Push(candidate_weight, target);
+                    }
+                }
+            }
+            return settled;
+        }
+
+    }  // namespace detail
+
+    // On-demand engine: no precompute, every query runs Dijkstra from `from` and stops at `to`.
+    // Search state lives in reusable workspaces, one per concurrently running query.
+    template <typename Weight>
+    class DijkstraRouter : public RouterBase<Weight> {
+    private:
+        using Graph = DirectedWeightedGraph<Weight>;
+
+    public:
+        using RouteInfo = typename RouterBase<Weight>::RouteInfo;
+
+        explicit DijkstraRouter(const Graph& graph);
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+        // One search from `from` for all targets
+        std::vector<std::optional<Weight>> GetRouteWeights(VertexId from,
+            const std::vector<VertexId>& targets) const override;
+
+    private:
+        using Workspace = detail::SearchState<Weight>;
+
+        static constexpr Weight ZERO_WEIGHT{};
+        const Graph& graph_;
+        detail::WorkspacePool<Workspace> workspaces_;
+    };
+
+    template <typename Weight>
+    DijkstraRouter<Weight>::DijkstraRouter(const Graph& graph)
+        : graph_(graph)
+    {
+        detail::CheckRoutableGraph(graph);
+    }
+
+    template <typename Weight>
+    std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::BuildRoute(VertexId from,
+        VertexId to) const {
+        if (from >= graph_.GetVertexCount() || to >= graph_.GetVertexCount()) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+
+        const auto holder = workspaces_.Acquire(graph_.GetVertexCount());
+        Workspace& workspace = *holder;
+        workspace.Start();
+
+        workspace.Reach(from, ZERO_WEIGHT, std::nullopt);
+        workspace.Push(ZERO_WEIGHT, from);
+
+        bool is_found = false;
+        while (!workspace.IsQueueEmpty()) {
+            const auto [weight, vertex] = workspace.Pop();
+
+            if (weight > workspace.weights[vertex]) {
+                continue;
+            }
+            if (vertex == to) {
+                is_found = true;
+                break;
+            }
+
+            const AdjacencySpan<Weight> adjacency = graph_.GetAdjacency(vertex);
+            for (size_t i = 0; i < adjacency.size; ++i) {
+                const VertexId target = adjacency.targets[i];
+                const Weight candidate_weight = weight + adjacency.weights[i];
+                if (!workspace.IsReached(target) || candidate_weight < workspace.weights[target]) {
+                    workspace.Reach(target, candidate_weight, adjacency.edge_ids[i]);
+                    workspace.Push(candidate_weight, target);
+                }
+            }
+        }
+
+        if (!is_found) {
+            return std::nullopt;
+        }
+
+        std::vector<EdgeId> edges;
+        for (std::optional<EdgeId> edge_id = workspace.prev_edges[to];
+            edge_id;
+            edge_id = workspace.prev_edges[graph_.GetEdge(*edge_id).from])
+        {
+            edges.push_back(*edge_id);
+        }
+        std::reverse(edges.begin(), edges.end());
+
+        return RouteInfo{ workspace.weights[to], std::move(edges) };
+    }
+
+    template <typename Weight>
+    std::vector<std::optional<Weight>> DijkstraRouter<Weight>::GetRouteWeights(VertexId from,
+        const std::vector<VertexId>& targets) const {
+        const auto holder = workspaces_.Acquire(graph_.GetVertexCount());
+        return detail::ComputeWeightsFrom(graph_, *holder, from, targets);
+    }
+
+}  // namespace graph
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -15,25 +16,44 @@ namespace transport_catalogue {
 
 		RouteType IntToRouteType(int i);
 
+		// Dense ids: stops and buses are numbered 0, 1, ... in the order they are added to the catalogue,
+		// so per-stop and per-bus data can live in plain arrays indexed by id
+		using StopId = uint32_t;
+		using BusId = uint32_t;
+
+		// Coordinates are kept by the catalogue, see TransportCatalogue::GetStopCoordinates
 		struct Stop {
 
 			Stop() = default;
-			Stop(const std::string& name) : name_(name) {}
-			Stop(const std::string& name, const geo::Coordinates& coords) : name_(name), coords_(coords) {}
+			Stop(const std::string& name, StopId id) : name_(name), id_(id) {}
 
 			std::string name_;
-			geo::Coordinates coords_{};
+			StopId id_ = 0;
 		};
 
 
 		struct Bus {
 
 			Bus() = default;
-			Bus(const std::string& name) :name_(name) {}
+			Bus(const std::string& name, BusId id) :name_(name), id_(id) {}
 
 			std::string name_;
-			std::vector<Stop*> stops_;
+			BusId id_ = 0;
+			std::vector<StopId> stop_ids_;
 			RouteType route_type_ = RouteType::ROUND;
 		};
+
+		// Figures of a bus route, as the Bus stat request reports them
+		struct BusStats {
+			// Road distance over the whole route, there and back for non-roundtrip buses
+			double route_length = 0.0;
+			// Great-circle distance over the same stops
+			double geo_length = 0.0;
+			// route_length / geo_length
+			double curvature = 0.0;
+			// Stops along the whole route, repeats included
+			size_t stop_count = 0;
+			size_t unique_stop_count = 0;
+		};
 	} // ------------------ namespace domain ----------------
 } // ------------------ namespace transport_catalogue ---------------- 
\ No newline at end of file
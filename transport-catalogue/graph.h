@@ -2,7 +2,9 @@
 
 #include "ranges.h"
 
+#include <cassert>
 #include <cstdlib>
+#include <stdexcept>
 #include <vector>
 
 namespace graph {
@@ -17,43 +19,130 @@ namespace graph {
         Weight weight;
     };
 
+    // Outgoing edges of one vertex in a frozen graph: parallel arrays of `size` elements
+    template <typename Weight>
+    struct AdjacencySpan {
+        const EdgeId* edge_ids;
+        const VertexId* targets;
+        const Weight* weights;
+        size_t size;
+    };
+
     template <typename Weight>
     class DirectedWeightedGraph {
     private:
         using IncidenceList = std::vector<EdgeId>;
-        using IncidentEdgesRange = ranges::Range<typename IncidenceList::const_iterator>;
+        using IncidentEdgesRange = ranges::Range<const EdgeId*>;
 
     public:
         DirectedWeightedGraph() = default;
         explicit DirectedWeightedGraph(size_t vertex_count);
         EdgeId AddEdge(const Edge<Weight>& edge);
 
+        // Converts the finished graph to compressed sparse row form: the outgoing edges of every
+        // vertex become one slice of contiguous edge id/target/weight arrays. No edges can be
+        // added afterwards; edge ids stay the same.
+        void Freeze();
+        bool IsFrozen() const;
+
         size_t GetVertexCount() const;
         size_t GetEdgeCount() const;
         const Edge<Weight>& GetEdge(EdgeId edge_id) const;
         IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
+        AdjacencySpan<Weight> GetAdjacency(VertexId vertex) const;
+
+        // Bytes held by edges, incidence lists and the CSR arrays
+        size_t GetMemoryUsage() const;
 
     private:
+        size_t vertex_count_ = 0;
         std::vector<Edge<Weight>> edges_;
         std::vector<IncidenceList> incidence_lists_;
+
+        bool is_frozen_ = false;
+        std::vector<size_t> offsets_;
+        std::vector<EdgeId> adjacency_edge_ids_;
+        std::vector<VertexId> adjacency_targets_;
+        std::vector<Weight> adjacency_weights_;
+    };
+
+    // Incoming edges of every vertex of a graph in the same CSR form, for searches that run backwards.
+    // In the spans `targets` are the tails of the edges.
+    template <typename Weight>
+    class ReverseAdjacency {
+    public:
+        explicit ReverseAdjacency(const DirectedWeightedGraph<Weight>& graph);
+
+        AdjacencySpan<Weight> GetAdjacency(VertexId vertex) const {
+            assert(vertex + 1 < offsets_.size());
+            const size_t begin = offsets_[vertex];
+            return { edge_ids_.data() + begin, sources_.data() + begin, weights_.data() + begin, offsets_[vertex + 1] - begin };
+        }
+
+        size_t GetMemoryUsage() const {
+            return offsets_.capacity() * sizeof(size_t) + edge_ids_.capacity() * sizeof(EdgeId)
+                + sources_.capacity() * sizeof(VertexId) + weights_.capacity() * sizeof(Weight);
+        }
+
+    private:
+        std::vector<size_t> offsets_;
+        std::vector<EdgeId> edge_ids_;
+        std::vector<VertexId> sources_;
+        std::vector<Weight> weights_;
     };
 
     template <typename Weight>
     DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
-        : incidence_lists_(vertex_count) {
+        : vertex_count_(vertex_count)
+        , incidence_lists_(vertex_count) {
     }
 
     template <typename Weight>
     EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
+        if (is_frozen_) {
+            throw std::logic_error("Can't add an edge to a frozen graph");
+        }
         edges_.push_back(edge);
         const EdgeId id = edges_.size() - 1;
         incidence_lists_.at(edge.from).push_back(id);
         return id;
     }
 
+    template <typename Weight>
+    void DirectedWeightedGraph<Weight>::Freeze() {
+        if (is_frozen_) {
+            return;
+        }
+        offsets_.assign(vertex_count_ + 1, 0);
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            offsets_[vertex + 1] = offsets_[vertex] + incidence_lists_[vertex].size();
+        }
+
+        adjacency_edge_ids_.reserve(edges_.size());
+        adjacency_targets_.reserve(edges_.size());
+        adjacency_weights_.reserve(edges_.size());
+        for (const IncidenceList& incidence_list : incidence_lists_) {
+            for (const EdgeId edge_id : incidence_list) {
+                adjacency_edge_ids_.push_back(edge_id);
+                adjacency_targets_.push_back(edges_[edge_id].to);
+                adjacency_weights_.push_back(edges_[edge_id].weight);
+            }
+        }
+
+        incidence_lists_.clear();
+        incidence_lists_.shrink_to_fit();
+        edges_.shrink_to_fit();
+        is_frozen_ = true;
+    }
+
+    template <typename Weight>
+    bool DirectedWeightedGraph<Weight>::IsFrozen() const {
+        return is_frozen_;
+    }
+
     template <typename Weight>
     size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-        return incidence_lists_.size();
+        return vertex_count_;
     }
 
     template <typename Weight>
@@ -63,12 +152,63 @@ namespace graph {
 
     template <typename Weight>
     const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const {
-        return edges_.at(edge_id);
+        assert(edge_id < edges_.size());
+        return edges_[edge_id];
     }
 
     template <typename Weight>
     typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
         DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
-        return ranges::AsRange(incidence_lists_.at(vertex));
+        if (vertex >= vertex_count_) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        if (is_frozen_) {
+            return { adjacency_edge_ids_.data() + offsets_[vertex], adjacency_edge_ids_.data() + offsets_[vertex + 1] };
+        }
+        const IncidenceList& incidence_list = incidence_lists_[vertex];
+        return { incidence_list.data(), incidence_list.data() + incidence_list.size() };
+    }
+
+    template <typename Weight>
+    AdjacencySpan<Weight> DirectedWeightedGraph<Weight>::GetAdjacency(VertexId vertex) const {
+        assert(is_frozen_ && vertex < vertex_count_);
+        const size_t begin = offsets_[vertex];
+        return { adjacency_edge_ids_.data() + begin, adjacency_targets_.data() + begin,
+            adjacency_weights_.data() + begin, offsets_[vertex + 1] - begin };
+    }
+
+    template <typename Weight>
+    size_t DirectedWeightedGraph<Weight>::GetMemoryUsage() const {
+        size_t bytes = edges_.capacity() * sizeof(Edge<Weight>) + incidence_lists_.capacity() * sizeof(IncidenceList);
+        for (const IncidenceList& incidence_list : incidence_lists_) {
+            bytes += incidence_list.capacity() * sizeof(EdgeId);
+        }
+        return bytes + offsets_.capacity() * sizeof(size_t) + adjacency_edge_ids_.capacity() * sizeof(EdgeId)
+            + adjacency_targets_.capacity() * sizeof(VertexId) + adjacency_weights_.capacity() * sizeof(Weight);
+    }
+
+    template <typename Weight>
+    ReverseAdjacency<Weight>::ReverseAdjacency(const DirectedWeightedGraph<Weight>& graph) {
+        const size_t vertex_count = graph.GetVertexCount();
+        const size_t edge_count = graph.GetEdgeCount();
+        offsets_.assign(vertex_count + 1, 0);
+        for (EdgeId edge_id = 0; edge_id < edge_count; ++edge_id) {
+            ++offsets_[graph.GetEdge(edge_id).to + 1];
+        }
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            offsets_[vertex + 1] += offsets_[vertex];
+        }
+
+        edge_ids_.resize(edge_count);
+        sources_.resize(edge_count);
+        weights_.resize(edge_count);
+        std::vector<size_t> positions(offsets_.begin(), offsets_.end() - 1);
+        for (EdgeId edge_id = 0; edge_id < edge_count; ++edge_id) {
+            const Edge<Weight>& edge = graph.GetEdge(edge_id);
+            const size_t position = positions[edge.to]++;
+            edge_ids_[position] = edge_id;
+            sources_[position] = edge.from;
+            weights_[position] = edge.weight;
+        }
     }
 }  // namespace graph
\ No newline at end of file
@@ -0,0 +1,306 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "search_workspace.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+    // 2-hop hub labeling engine. Every vertex v gets a forward label, hubs h with d(v, h), and a
+    // backward label, hubs h with d(h, v), such that for any pair some hub on a shortest path is in
+    // both labels. A query is then a merge-join of two short sorted arrays. Labels are built by pruned
+    // Dijkstra searches from every vertex in order of importance: a search stops at vertices whose
+    // distance the labels built so far already cover. Memory is the total label size, far below V^2
+    // on road-like networks. Each label entry also keeps the first (forward) or last (backward) edge of
+    // its path; the rest of the path is in the labels of the next vertex, so routes expand into EdgeIds.
+    template <typename Weight>
+    class HubLabelsRouter : public RouterBase<Weight> {
+    private:
+        using Graph = DirectedWeightedGraph<Weight>;
+
+    public:
+        using RouteInfo = typename RouterBase<Weight>::RouteInfo;
+        using HubRank = uint32_t;
+
+        explicit HubLabelsRouter(const Graph& graph);
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+        // Label merges only, no path expansion
+        std::vector<std::optional<Weight>> GetRouteWeights(VertexId from,
+            const std::vector<VertexId>& targets) const override;
+
+        // Average number of entries per label
+        double GetAverageLabelSize() const {
+            const size_t vertex_count = graph_.GetVertexCount();
+            return vertex_count == 0 ? 0.0
+                : static_cast<double>(forward_labels_.hubs.size() + backward_labels_.hubs.size()) / (2 * vertex_count);
+        }
+
+        size_t GetMemoryUsage() const {
+            return forward_labels_.GetMemoryUsage() + backward_labels_.GetMemoryUsage()
+                + vertex_by_rank_.capacity() * sizeof(VertexId);
+        }
+
+    private:
+        static constexpr uint32_t NO_EDGE = std::numeric_limits<uint32_t>::max();
+
+        // Labels of all vertices in CSR form, entries of each label sorted by hub rank. Hubs, weights
+        // and edges are separate contiguous arrays, so the merge in a query only streams hubs and weights.
+        struct Labels {
+            std::vector<size_t> offsets;
+            std::vector<HubRank> hubs;
+            std::vector<Weight> weights;
+            std::vector<uint32_t> edges;
+
+            size_t GetMemoryUsage() const {
+                return offsets.capacity() * sizeof(size_t) + hubs.capacity() * sizeof(HubRank)
+                    + weights.capacity() * sizeof(Weight) + edges.capacity() * sizeof(uint32_t);
+            }
+        };
+
+        struct LabelEntry {
+            HubRank hub;
+            Weight weight;
+            uint32_t edge;
+        };
+
+        using LabelLists = std::vector<std::vector<LabelEntry>>;
+
+        struct Meeting {
+            Weight weight;
+            HubRank hub;
+        };
+
+        // Adds `hub` to the labels of every vertex a pruned search from it settles. The search runs over
+        // `get_adjacency`; `own_labels` are the labels it fills, `root_labels` the opposite labels of the hub.
+        template <typename GetAdjacency>
+        static void RunPrunedSearch(GetAdjacency get_adjacency, VertexId root, HubRank hub,
+            LabelLists& own_labels, const std::vector<LabelEntry>& root_labels,
+            detail::SearchState<Weight>& state, std::vector<std::optional<Weight>>& root_weights);
+
+        static Labels Flatten(LabelLists& label_lists);
+
+        std::optional<Meeting> FindMeeting(VertexId from, VertexId to) const;
+
+        // Index of `hub` in the label of `vertex`; the hub must be there
+        static size_t FindEntry(const Labels& labels, VertexId vertex, HubRank hub);
+
+        static constexpr Weight ZERO_WEIGHT{};
+        const Graph& graph_;
+        std::vector<VertexId> vertex_by_rank_;
+        Labels forward_labels_;
+        Labels backward_labels_;
+    };
+
+    // Vertices with more edges go first: they lie on many shortest paths, and hubs found early prune
+    // the later searches the most
+    template <typename Weight>
+    HubLabelsRouter<Weight>::HubLabelsRouter(const Graph& graph)
+        : graph_(graph)
+    {
+        detail::CheckRoutableGraph(graph);
+        const size_t vertex_count = graph.GetVertexCount();
+        if (graph.GetEdgeCount() >= NO_EDGE || vertex_count >= std::numeric_limits<HubRank>::max()) {
+            throw std::length_error("Graph is too large for hub labels");
+        }
+
+        const ReverseAdjacency<Weight> reverse_adjacency(graph);
+        std::vector<size_t> degrees(vertex_count);
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            degrees[vertex] = graph.GetAdjacency(vertex).size + reverse_adjacency.GetAdjacency(vertex).size;
+        }
+        vertex_by_rank_.resize(vertex_count);
+        std::iota(vertex_by_rank_.begin(), vertex_by_rank_.end(), 0);
+        std::stable_sort(vertex_by_rank_.begin(), vertex_by_rank_.end(), [&degrees](VertexId lhs, VertexId rhs) {
+            return degrees[lhs] > degrees[rhs];
+        });
+
+        LabelLists forward_lists(vertex_count);
+        LabelLists backward_lists(vertex_count);
+        detail::SearchState<Weight> state(vertex_count);
+        std::vector<std::optional<Weight>> root_weights(vertex_count);
+        for (HubRank hub = 0; hub < vertex_count; ++hub) {
+            const VertexId root = vertex_by_rank_[hub];
+            // Forward search finds d(hub, v): backward labels of the settled vertices
+            RunPrunedSearch([&graph](VertexId vertex) { return graph.GetAdjacency(vertex); },
+                root, hub, backward_lists, forward_lists[root], state, root_weights);
+            RunPrunedSearch([&reverse_adjacency](VertexId vertex) { return reverse_adjacency.GetAdjacency(vertex); },
+                root, hub, forward_lists, backward_lists[root], state, root_weights);
+        }
+
+        forward_labels_ = Flatten(forward_lists);
+        backward_labels_ = Flatten(backward_lists);
+    }
+
+    // A settled vertex is pruned when the labels already give a path from the hub at most as long;
+    // it gets no entry and isn't expanded. So the previous vertex on the search tree path of every
+    // entry has an entry for the same hub, which path expansion relies on.
+    template <typename Weight>
+    template <typename GetAdjacency>
+    void HubLabelsRouter<Weight>::RunPrunedSearch(GetAdjacency get_adjacency, VertexId root, HubRank hub,
+        LabelLists& own_labels, const std::vector<LabelEntry>& root_labels,
+        detail::SearchState<Weight>& state, std::vector<std::optional<Weight>>& root_weights) {
+        for (const LabelEntry& entry : root_labels) {
+            root_weights[entry.hub] = entry.weight;
+        }
+
+        state.Start();
+        state.Reach(root, ZERO_WEIGHT, std::nullopt);
+        state.Push(ZERO_WEIGHT, root);
+        while (!state.IsQueueEmpty()) {
+            const auto [weight, vertex] = state.Pop();
+            if (weight > state.weights[vertex]) {
+                continue;
+            }
+            const bool is_covered = std::any_of(own_labels[vertex].begin(), own_labels[vertex].end(),
+                [&root_weights, weight = weight](const LabelEntry& entry) {
+                    return root_weights[entry.hub] && !(weight < *root_weights[entry.hub] + entry.weight);
+                });
+            if (is_covered) {
+                continue;
+            }
+            const std::optional<EdgeId>& prev_edge = state.prev_edges[vertex];
+            own_labels[vertex].push_back({ hub, weight, prev_edge ? static_cast<uint32_t>(*prev_edge) : NO_EDGE });
+
+            const AdjacencySpan<Weight> adjacency = get_adjacency(vertex);
+            for (size_t i = 0; i < adjacency.size; ++i) {
+                const VertexId target = adjacency.targets[i];
+                const Weight candidate_weight = weight + adjacency.weights[i];
+                if (!state.IsReached(target) || candidate_weight < state.weights[target]) {
+                    state.Reach(target, candidate_weight, adjacency.edge_ids[i]);
+                    state.Push(candidate_weight, target);
+                }
+            }
+        }
+
+        for (const LabelEntry& entry : root_labels) {
+            root_weights[entry.hub].reset();
+        }
+    }
+
+    template <typename Weight>
+    typename HubLabelsRouter<Weight>::Labels HubLabelsRouter<Weight>::Flatten(LabelLists& label_lists) {
+        Labels labels;
+        labels.offsets.reserve(label_lists.size() + 1);
+        labels.offsets.push_back(0);
+        for (const auto& list : label_lists) {
+            labels.offsets.push_back(labels.offsets.back() + list.size());
+        }
+        labels.hubs.reserve(labels.offsets.back());
+        labels.weights.reserve(labels.offsets.back());
+        labels.edges.reserve(labels.offsets.back());
+        for (auto& list : label_lists) {
+            for (const LabelEntry& entry : list) {
+                labels.hubs.push_back(entry.hub);
+                labels.weights.push_back(entry.weight);
+                labels.edges.push_back(entry.edge);
+            }
+            std::vector<LabelEntry>().swap(list);
+        }
+        return labels;
+    }
+
+    template <typename Weight>
+    std::optional<typename HubLabelsRouter<Weight>::Meeting> HubLabelsRouter<Weight>::FindMeeting(VertexId from, VertexId to) const {
+        const size_t vertex_count = graph_.GetVertexCount();
+        if (from >= vertex_count || to >= vertex_count) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+
+        const HubRank* forward_hubs = forward_labels_.hubs.data();
+        const Weight* forward_weights = forward_labels_.weights.data();
+        const HubRank* backward_hubs = backward_labels_.hubs.data();
+        const Weight* backward_weights = backward_labels_.weights.data();
+        size_t i = forward_labels_.offsets[from];
+        const size_t i_end = forward_labels_.offsets[from + 1];
+        size_t j = backward_labels_.offsets[to];
+        const size_t j_end = backward_labels_.offsets[to + 1];
+
+        std::optional<Meeting> meeting;
+        while (i < i_end && j < j_end) {
+            if (forward_hubs[i] < backward_hubs[j]) {
+                ++i;
+            }
+            else if (backward_hubs[j] < forward_hubs[i]) {
+                ++j;
+            }
+            else {
+                const Weight weight = forward_weights[i] + backward_weights[j];
+                if (!meeting || weight < meeting->weight) {
+                    meeting = Meeting{ weight, forward_hubs[i] };
+                }
+                ++i;
+                ++j;
+            }
+        }
+        return meeting;
+    }
+
+    template <typename Weight>
+    size_t HubLabelsRouter<Weight>::FindEntry(const Labels& labels, VertexId vertex, HubRank hub) {
+        const auto begin = labels.hubs.begin() + labels.offsets[vertex];
+        const auto end = labels.hubs.begin() + labels.offsets[vertex + 1];
+        const auto it = std::lower_bound(begin, end, hub);
+        assert(it != end && *it == hub);
+        return it - labels.hubs.begin();
+    }
+
+    template <typename Weight>
+    std::optional<typename HubLabelsRouter<Weight>::RouteInfo> HubLabelsRouter<Weight>::BuildRoute(VertexId from,
+        VertexId to) const {
+        const std::optional<Meeting> meeting = FindMeeting(from, to);
+        if (!meeting) {
+            return std::nullopt;
+        }
+        if (from == to) {
+            return RouteInfo{ ZERO_WEIGHT, {} };
+        }
+
+        // from -> hub: first edges of forward entries; hub -> to: last edges of backward entries
+        std::vector<EdgeId> edges;
+        for (VertexId vertex = from;;) {
+            const uint32_t edge_id = forward_labels_.edges[FindEntry(forward_labels_, vertex, meeting->hub)];
+            if (edge_id == NO_EDGE) {
+                break;
+            }
+            edges.push_back(edge_id);
+            vertex = graph_.GetEdge(edge_id).to;
+        }
+        const size_t forward_size = edges.size();
+        for (VertexId vertex = to;;) {
+            const uint32_t edge_id = backward_labels_.edges[FindEntry(backward_labels_, vertex, meeting->hub)];
+            if (edge_id == NO_EDGE) {
+                break;
+            }
+            edges.push_back(edge_id);
+            vertex = graph_.GetEdge(edge_id).from;
+        }
+        std::reverse(edges.begin() + forward_size, edges.end());
+
+        return RouteInfo{ meeting->weight, std::move(edges) };
+    }
+
+    template <typename Weight>
+    std::vector<std::optional<Weight>> HubLabelsRouter<Weight>::GetRouteWeights(VertexId from,
+        const std::vector<VertexId>& targets) const {
+        std::vector<std::optional<Weight>> weights;
+        weights.reserve(targets.size());
+        for (const VertexId to : targets) {
+            const std::optional<Meeting> meeting = FindMeeting(from, to);
+            weights.push_back(meeting ? std::optional<Weight>(meeting->weight) : std::nullopt);
+        }
+        return weights;
+    }
+
+}  // namespace graph
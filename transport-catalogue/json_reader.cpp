@@ -23,6 +23,7 @@ namespace transport_catalogue {
 			FillStatRequests();
 			FillRenderSettings();
 			FillRoutingSettings();
+			FillSerializationSettings();
 		}
 
 		const std::vector<const json::Node*>& JSONReader::GetStatRequests() const {
@@ -49,6 +50,18 @@ namespace transport_catalogue {
 			return render_settings_;
 		}
 
+		const std::unordered_map<std::string_view, const json::Node*>& JSONReader::GetSerializationSettings() const {
+			return serialization_settings_;
+		}
+
+		const json::Node& JSONReader::GetBaseRequestsNode() const {
+			return commands_.GetRoot().AsDict().at("base_requests");
+		}
+
+		const json::Node& JSONReader::GetRoutingSettingsNode() const {
+			return commands_.GetRoot().AsDict().at("routing_settings");
+		}
+
 
 
 		void JSONReader::FillBusRequests() {
@@ -108,6 +121,17 @@ namespace transport_catalogue {
 				routing_settings_.insert({ setting, data.AsDouble()});
 			}
 		}
+
+		void JSONReader::FillSerializationSettings() {
+			const json::Dict& root = commands_.GetRoot().AsDict();
+			if (root.count("serialization_settings") == 0) {
+				return;
+			}
+
+			for (auto& [setting, data] : root.at("serialization_settings").AsDict()) {
+				serialization_settings_.insert({ setting, &data });
+			}
+		}
 	} // ------------------ namespace json_reader ----------------
 
 } // ------------------ namespace transport_catalogue ----------------
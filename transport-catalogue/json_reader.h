@@ -31,6 +31,13 @@ namespace transport_catalogue {
 
 			const std::unordered_map<std::string_view, const json::Dict*>& GetRoadDistances() const;
 
+			// Empty when the input has no "serialization_settings"
+			const std::unordered_map<std::string_view, const json::Node*>& GetSerializationSettings() const;
+
+			// Raw input the routing data is built from, e.g. to key saved routes
+			const json::Node& GetBaseRequestsNode() const;
+			const json::Node& GetRoutingSettingsNode() const;
+
 		private:
 
 			
@@ -39,6 +46,7 @@ namespace transport_catalogue {
 			void FillStatRequests();
 			void FillRenderSettings();
 			void FillRoutingSettings();
+			void FillSerializationSettings();
 
 			json::Document commands_;
 			std::vector<const json::Node*> stat_requests_;
@@ -47,6 +55,7 @@ namespace transport_catalogue {
 			std::unordered_map<std::string_view, const double> routing_settings_;
 			std::unordered_map<std::string_view, const json::Node*> render_settings_;
 			std::unordered_map<std::string_view, const json::Dict*> road_distances_;
+			std::unordered_map<std::string_view, const json::Node*> serialization_settings_;
 		};
 	} // ------------------ namespace json_reader ----------------
 
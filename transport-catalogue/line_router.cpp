@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "line_router.h"
+
+using namespace transport_graph;
+
+namespace {
+
+	constexpr TransportTime INFINITE_TIME = std::numeric_limits<TransportTime>::has_infinity
+		? std::numeric_limits<TransportTime>::infinity() : std::numeric_limits<TransportTime>::max();
+
+}
+
+LineRouter::LineRouter(const TransportCatalogue& catalogue)
+	:catalogue_(catalogue) {
+	const auto settings = catalogue.GetRoutingSettings();
+	bus_wait_time_ = ToTransportTime(settings.bus_wait_time);
+	bus_velocity_ = settings.bus_velocity;
+	ride_units_per_meter_ = TO_MINUTES * TIME_UNITS_PER_MINUTE / bus_velocity_;
+
+	for (domain::StopId stop_id = 0; stop_id < catalogue.GetStops().size(); ++stop_id) {
+		stops_.push_back(catalogue.GetStop(stop_id));
+	}
+
+	std::vector<VisitIndex> last_stop_visits(stops_.size(), NONE);
+	const auto add_line = [this, &last_stop_visits](const auto& bus_range) {
+		const uint32_t line = static_cast<uint32_t>(line_buses_.size());
+		const VisitIndex line_begin = static_cast<VisitIndex>(visit_stops_.size());
+		bool is_single_stop = true;
+		for (const StopIndex stop_index : bus_range) {
+			const VisitIndex visit = static_cast<VisitIndex>(visit_stops_.size());
+			double distance = 0.0;
+			if (visit != line_begin) {
+				// The edge model reads a segment only when riding into it from another stop
+				is_single_stop = is_single_stop && stop_index == visit_stops_[line_begin];
+				if (!is_single_stop) {
+					distance = catalogue_.GetDistance(visit_stops_[visit - 1], stop_index);
+				}
+			}
+			visit_stops_.push_back(stop_index);
+			visit_lines_.push_back(line);
+			visit_distances_.push_back(distance);
+			next_stop_visits_.push_back(NONE);
+			if (last_stop_visits[stop_index] != NONE) {
+				next_stop_visits_[last_stop_visits[stop_index]] = visit;
+			}
+			last_stop_visits[stop_index] = visit;
+		}
+		// Riding back into the boarding stop at the end of the line can't improve it, so a boarding
+		// there needs no skip. This keeps roundtrip lines down to a single boarding
+		const VisitIndex line_end = static_cast<VisitIndex>(visit_stops_.size());
+		for (VisitIndex visit = line_begin; visit + 1 < line_end; ++visit) {
+			if (next_stop_visits_[visit] == line_end - 1) {
+				next_stop_visits_[visit] = NONE;
+			}
+		}
+		for (VisitIndex visit = line_begin; visit < line_end; ++visit) {
+			last_stop_visits[visit_stops_[visit]] = NONE;
+		}
+		line_buses_.push_back(bus_range.GetPtr());
+		line_offsets_.push_back(static_cast<VisitIndex>(visit_stops_.size()));
+	};
+
+	line_offsets_.push_back(0);
+	for (domain::BusId bus_id = 0; bus_id < catalogue.GetBuses().size(); ++bus_id) {
+		const domain::Bus* bus_ptr = catalogue.GetBus(bus_id);
+		add_line(ranges::AsBusRangeDirect(bus_ptr));
+		if (bus_ptr->route_type_ == domain::RouteType::DIRECT) {
+			add_line(ranges::AsBusRangeReversed(bus_ptr));
+		}
+	}
+
+	// Counting sort of the visits by stop
+	stop_visit_offsets_.assign(stops_.size() + 1, 0);
+	for (const StopIndex stop : visit_stops_) {
+		++stop_visit_offsets_[stop + 1];
+	}
+	for (size_t i = 1; i < stop_visit_offsets_.size(); ++i) {
+		stop_visit_offsets_[i] += stop_visit_offsets_[i - 1];
+	}
+	stop_visits_.resize(visit_stops_.size());
+	std::vector<VisitIndex> next_slot(stop_visit_offsets_.begin(), stop_visit_offsets_.end() - 1);
+	for (VisitIndex visit = 0; visit < visit_stops_.size(); ++visit) {
+		stop_visits_[next_slot[visit_stops_[visit]]++] = visit;
+	}
+}
+
+void LineRouter::Scan(Workspace& workspace, StopIndex from, std::optional<StopIndex> bound_stop) const {
+	if (++workspace.stamp == 0) {
+		std::fill(workspace.stamps.begin(), workspace.stamps.end(), 0);
+		workspace.stamp = 1;
+	}
+	const auto get_time = [&workspace](StopIndex stop) {
+		return workspace.stamps[stop] == workspace.stamp ? workspace.times[stop] : INFINITE_TIME;
+	};
+	const auto reach = [&workspace](StopIndex stop, TransportTime time, Arrival arrival) {
+		workspace.stamps[stop] = workspace.stamp;
+		workspace.times[stop] = time;
+		workspace.arrivals[stop] = arrival;
+		if (!workspace.is_marked[stop]) {
+			workspace.is_marked[stop] = true;
+			workspace.marked_stops.push_back(stop);
+		}
+	};
+
+	workspace.marked_stops.clear();
+	reach(from, 0, Arrival{});
+
+	while (!workspace.marked_stops.empty()) {
+		// Every line through an improved stop is scanned once, from its earliest improved visit
+		workspace.touched_lines.clear();
+		for (const StopIndex stop : workspace.marked_stops) {
+			workspace.is_marked[stop] = false;
+			for (VisitIndex i = stop_visit_offsets_[stop]; i < stop_visit_offsets_[stop + 1]; ++i) {
+				const VisitIndex visit = stop_visits_[i];
+				const uint32_t line = visit_lines_[visit];
+				if (workspace.line_start[line] == NONE) {
+					workspace.touched_lines.push_back(line);
+					workspace.line_start[line] = visit;
+				}
+				else {
+					workspace.line_start[line] = std::min(workspace.line_start[line], visit);
+				}
+			}
+		}
+		workspace.marked_stops.clear();
+
+		for (const uint32_t line : workspace.touched_lines) {
+			const VisitIndex start = workspace.line_start[line];
+			workspace.line_start[line] = NONE;
+
+			// Boardings at one stop skip the same segments, so of those only the earliest on the bus
+			// is kept. A boarding with no skips left gains at least as much as any other from then on,
+			// so of those too only the earliest is kept, and most lines never carry anything else
+			Boarding plain;
+			std::vector<Boarding>& skipping = workspace.boardings;
+			skipping.clear();
+			const auto ride = [this](Boarding& boarding, double distance) {
+				boarding.distance += distance;
+				boarding.time = boarding.board_time + bus_wait_time_ + GetExactRideTime(boarding.distance);
+			};
+
+			for (VisitIndex visit = start; visit < line_offsets_[line + 1]; ++visit) {
+				const StopIndex stop = visit_stops_[visit];
+				TransportTime stop_time = get_time(stop);
+
+				// Ride every boarding on to this visit, timing it from its boarding stop as an edge would
+				Boarding best;
+				best.time = std::numeric_limits<double>::infinity();
+				if (plain.board_visit != NONE) {
+					ride(plain, visit_distances_[visit]);
+					best = plain;
+				}
+				size_t same_stop = NONE;
+				for (size_t i = 0; i < skipping.size(); ++i) {
+					Boarding& boarding = skipping[i];
+					if (boarding.skip_visit == visit) {
+						boarding.skip_visit = next_stop_visits_[visit];
+						same_stop = i;
+						continue;
+					}
+					ride(boarding, visit_distances_[visit]);
+					if (boarding.time < best.time) {
+						best = boarding;
+					}
+				}
+
+				// Rounding moves a time by half a unit at most, so most visits are settled before it
+				if (best.time < stop_time + 1.0) {
+					const TransportTime time = best.board_time + (bus_wait_time_ + GetRideTime(best.distance));
+					const TransportTime bound = bound_stop ? get_time(*bound_stop) : INFINITE_TIME;
+					if (time < stop_time && time < bound) {
+						reach(stop, time, Arrival{ best.board_visit, visit });
+						stop_time = time;
+					}
+				}
+
+				if (same_stop != NONE && skipping[same_stop].skip_visit == NONE) {
+					if (plain.board_visit == NONE || skipping[same_stop].time < plain.time) {
+						plain = skipping[same_stop];
+					}
+					skipping.erase(skipping.begin() + same_stop);
+					same_stop = NONE;
+				}
+				if (stop_time == INFINITE_TIME) {
+					continue;
+				}
+
+				const Boarding boarding{ visit, stop_time, 0.0, next_stop_visits_[visit], static_cast<double>(stop_time + bus_wait_time_) };
+				if (boarding.skip_visit == NONE) {
+					if (boarding.time < best.time && (plain.board_visit == NONE || boarding.time < plain.time)) {
+						plain = boarding;
+					}
+				}
+				else if (same_stop == NONE) {
+					skipping.push_back(boarding);
+				}
+				else if (boarding.time < skipping[same_stop].time) {
+					skipping[same_stop] = boarding;
+				}
+			}
+		}
+	}
+}
+
+LineRouter::Ride LineRouter::GetRide(VisitIndex board_visit, VisitIndex alight_visit) const {
+	const StopIndex stop_from = visit_stops_[board_visit];
+	Ride ride;
+	double full_distance = 0.0;
+	for (VisitIndex visit = board_visit + 1; visit <= alight_visit; ++visit) {
+		if (visit_stops_[visit] != stop_from) {
+			full_distance += visit_distances_[visit];
+			++ride.span_count;
+		}
+	}
+	ride.time = GetRideTime(full_distance);
+	return ride;
+}
+
+std::optional<TransportRouter::TransportRouterData> LineRouter::GetRoute(const domain::Stop* from, const domain::Stop* to) const {
+	const StopIndex from_index = from->id_;
+	const StopIndex to_index = to->id_;
+
+	const auto holder = workspaces_.Acquire(stops_.size(), line_buses_.size());
+	Workspace& workspace = *holder;
+	Scan(workspace, from_index, to_index);
+	if (workspace.stamps[to_index] != workspace.stamp) {
+		return std::nullopt;
+	}
+
+	TransportRouter::TransportRouterData output_data;
+	output_data.time = workspace.times[to_index];
+	for (StopIndex stop = to_index; stop != from_index;) {
+		// Arrivals are recorded on strict improvements only, so the chain can't revisit a stop
+		if (output_data.route.size() >= 2 * stops_.size()) {
+			throw std::logic_error("Arrivals don't lead back to the start stop");
+		}
+		const Arrival& arrival = workspace.arrivals[stop];
+		const StopIndex board_stop = visit_stops_[arrival.board_visit];
+		const Ride ride = GetRide(arrival.board_visit, arrival.alight_visit);
+		output_data.route.push_back({ stops_[board_stop], stops_[stop], line_buses_[visit_lines_[arrival.board_visit]],
+			ride.span_count, ride.time });
+		output_data.route.push_back({ stops_[board_stop], stops_[board_stop], nullptr, 0, bus_wait_time_ });
+		stop = board_stop;
+	}
+	std::reverse(output_data.route.begin(), output_data.route.end());
+	return output_data;
+}
+
+std::vector<std::optional<TransportTime>> LineRouter::GetTravelTimes(const domain::Stop* from,
+	const std::vector<const domain::Stop*>& destinations) const {
+	const auto holder = workspaces_.Acquire(stops_.size(), line_buses_.size());
+	Workspace& workspace = *holder;
+	Scan(workspace, from->id_, std::nullopt);
+
+	std::vector<std::optional<TransportTime>> times;
+	times.reserve(destinations.size());
+	for (const domain::Stop* stop : destinations) {
+		const StopIndex index = stop->id_;
+		times.push_back(workspace.stamps[index] == workspace.stamp ? std::optional<TransportTime>(workspace.times[index]) : std::nullopt);
+	}
+	return times;
+}
+
+std::vector<std::pair<const domain::Stop*, TransportTime>> LineRouter::GetReachableStops(const domain::Stop* from,
+	TransportTime max_time) const {
+	const auto holder = workspaces_.Acquire(stops_.size(), line_buses_.size());
+	Workspace& workspace = *holder;
+	Scan(workspace, from->id_, std::nullopt);
+
+	std::vector<std::pair<const domain::Stop*, TransportTime>> reachable;
+	for (StopIndex stop = 0; stop < stops_.size(); ++stop) {
+		if (workspace.stamps[stop] == workspace.stamp && !(workspace.times[stop] > max_time)) {
+			reachable.push_back({ stops_[stop], workspace.times[stop] });
+		}
+	}
+	return reachable;
+}
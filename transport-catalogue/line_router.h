@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "domain.h"
+#include "search_workspace.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+namespace transport_graph {
+
+	// Line-based model: instead of an edge between every pair of stops of a bus, keeps the ordered
+	// stop sequences of the buses (both directions for non-roundtrip ones), so memory is linear in
+	// the number of stop visits. A query runs route-scanning rounds as in RAPTOR: every round scans
+	// the lines through the stops improved in the previous one, carrying the best boarding points
+	// along the line, until no stop improves. Answers match the edge graph model.
+	class LineRouter {
+	public:
+		explicit LineRouter(const TransportCatalogue& catalogue);
+
+		std::optional<TransportRouter::TransportRouterData> GetRoute(const domain::Stop* from, const domain::Stop* to) const;
+
+		// Travel times from `from` to each of `destinations`, nullopt where unreachable
+		std::vector<std::optional<TransportTime>> GetTravelTimes(const domain::Stop* from,
+			const std::vector<const domain::Stop*>& destinations) const;
+
+		// Stops reachable from `from` within `max_time` with their travel times, in no particular order
+		std::vector<std::pair<const domain::Stop*, TransportTime>> GetReachableStops(const domain::Stop* from, TransportTime max_time) const;
+
+		size_t GetStopVisitCount() const {
+			return visit_stops_.size();
+		}
+
+	private:
+		// Stops are indexed by their ids
+		using StopIndex = domain::StopId;
+		using VisitIndex = uint32_t;
+		static constexpr uint32_t NONE = UINT32_MAX;
+
+		// How a stop was reached: boarded a line at `board_visit`, left it at `alight_visit`
+		struct Arrival {
+			VisitIndex board_visit = NONE;
+			VisitIndex alight_visit = NONE;
+		};
+
+		// A boarding carried along a line scan. Like the edge graph model, a ride skips the segments
+		// leading back into its boarding stop, so until `skip_visit` is passed an earlier boarding
+		// can still overtake a later one
+		struct Boarding {
+			VisitIndex board_visit = NONE;
+			TransportTime board_time{};
+			double distance = 0.0;
+			VisitIndex skip_visit = NONE;
+			// Time on the bus at the last visit ridden, before rounding: rounding keeps the order,
+			// so boardings compared by it compare the same at every later visit
+			double time = 0.0;
+		};
+
+		// Number of stops and ride time of a ride between two visits of one line
+		struct Ride {
+			int span_count = 0;
+			TransportTime time{};
+		};
+
+		struct Workspace {
+			Workspace(size_t stop_count, size_t line_count)
+				: times(stop_count)
+				, arrivals(stop_count)
+				, stamps(stop_count, 0)
+				, is_marked(stop_count, false)
+				, line_start(line_count, NONE) {
+			}
+
+			std::vector<TransportTime> times;
+			std::vector<Arrival> arrivals;
+			std::vector<uint32_t> stamps;
+			std::vector<bool> is_marked;
+			std::vector<VisitIndex> line_start;
+			std::vector<StopIndex> marked_stops;
+			std::vector<uint32_t> touched_lines;
+			std::vector<Boarding> boardings;
+			uint32_t stamp = 0;
+		};
+
+		// Fills the workspace with the best times from `from`; stops improving past `bound_stop`
+		// once it's reached, if given
+		void Scan(Workspace& workspace, StopIndex from, std::optional<StopIndex> bound_stop) const;
+
+		// Ride between two visits of one line, counted and summed the same way the edge graph model does
+		Ride GetRide(VisitIndex board_visit, VisitIndex alight_visit) const;
+
+		TransportTime GetRideTime(double distance) const {
+			return ToTransportTime((distance / bus_velocity_) * TO_MINUTES);
+		}
+
+		double GetExactRideTime(double distance) const {
+			return distance * ride_units_per_meter_;
+		}
+
+		const TransportCatalogue& catalogue_;
+		TransportTime bus_wait_time_{};
+		double bus_velocity_{};
+		double ride_units_per_meter_{};
+
+		std::vector<const domain::Stop*> stops_;
+
+		// Lines are contiguous runs of visits: line i covers [line_offsets_[i], line_offsets_[i + 1])
+		std::vector<VisitIndex> line_offsets_;
+		std::vector<const domain::Bus*> line_buses_;
+		std::vector<StopIndex> visit_stops_;
+		std::vector<uint32_t> visit_lines_;
+		// Road distance from the previous visit of the line, zero where the edge model never reads it
+		std::vector<double> visit_distances_;
+		// Next visit of the same stop on the same line, NONE after the last one but the line's end
+		std::vector<VisitIndex> next_stop_visits_;
+
+		// Visits of each stop: stop i has [stop_visit_offsets_[i], stop_visit_offsets_[i + 1])
+		std::vector<VisitIndex> stop_visit_offsets_;
+		std::vector<VisitIndex> stop_visits_;
+
+		graph::detail::WorkspacePool<Workspace> workspaces_;
+	};
+
+}
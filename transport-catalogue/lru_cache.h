@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace cache {
+
+    struct CacheStats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    // Thread-safe least-recently-used cache bounded by an approximate byte budget.
+    // Callers report the heap bytes of each value; per-entry bookkeeping is added on top.
+    // A zero budget disables the cache.
+    template <typename Key, typename Value, typename Hash = std::hash<Key>>
+    class LruCache {
+    public:
+        explicit LruCache(size_t byte_budget)
+            : byte_budget_(byte_budget) {
+        }
+
+        size_t GetByteBudget() const {
+            return byte_budget_;
+        }
+
+        // Copy of the cached value, marked as most recently used
+        std::optional<Value> Get(const Key& key) {
+            if (byte_budget_ == 0) {
+                return std::nullopt;
+            }
+            std::lock_guard lock(mutex_);
+            const auto it = index_.find(key);
+            if (it == index_.end()) {
+                ++stats_.misses;
+                return std::nullopt;
+            }
+            ++stats_.hits;
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return it->second->value;
+        }
+
+        // Inserts or replaces the value, evicting the least recently used entries to fit
+        void Put(const Key& key, Value value, size_t value_heap_bytes) {
+            const size_t bytes = ENTRY_OVERHEAD + value_heap_bytes;
+            if (bytes > byte_budget_) {
+                return;
+            }
+            std::lock_guard lock(mutex_);
+            if (const auto it = index_.find(key); it != index_.end()) {
+                Erase(it->second);
+            }
+            while (stats_.bytes + bytes > byte_budget_) {
+                Erase(std::prev(entries_.end()));
+                ++stats_.evictions;
+            }
+            entries_.push_front(Entry{ key, std::move(value), bytes });
+            index_.emplace(key, entries_.begin());
+            stats_.bytes += bytes;
+            ++stats_.entries;
+        }
+
+        // Drops every entry; counters are kept
+        void Clear() {
+            std::lock_guard lock(mutex_);
+            entries_.clear();
+            index_.clear();
+            stats_.entries = 0;
+            stats_.bytes = 0;
+        }
+
+        CacheStats GetStats() const {
+            std::lock_guard lock(mutex_);
+            return stats_;
+        }
+
+    private:
+        struct Entry {
+            Key key;
+            Value value;
+            size_t bytes;
+        };
+        using EntryIterator = typename std::list<Entry>::iterator;
+
+        // List node plus hash node, roughly
+        static constexpr size_t ENTRY_OVERHEAD = sizeof(Entry) + sizeof(Key) + sizeof(EntryIterator) + 4 * sizeof(void*);
+
+        void Erase(EntryIterator it) {
+            stats_.bytes -= it->bytes;
+            --stats_.entries;
+            index_.erase(it->key);
+            entries_.erase(it);
+        }
+
+        const size_t byte_budget_;
+        mutable std::mutex mutex_;
+        std::list<Entry> entries_;
+        std::unordered_map<Key, EntryIterator, Hash> index_;
+        CacheStats stats_;
+    };
+
+}  // namespace cache
@@ -108,9 +108,9 @@ namespace transport_catalogue {
 
 		MapRenderer::MapRenderer(
 			MapRenderSettings&& settings,
-			std::vector<domain::Bus*> buses
-			) :MapRendererBase(std::move(settings)) {
-			InitNotEmptyBusesAndStops(buses);
+			const TransportCatalogue& catalogue
+			) :MapRendererBase(std::move(settings)), catalogue_(catalogue) {
+			InitNotEmptyBusesAndStops();
 
 			std::vector<geo::Coordinates> coords = GetAllCoords();
 			sphere_projector::SphereProjector projector(coords.begin(), coords.end(), settings_.width, settings_.height, settings_.padding);
@@ -120,22 +120,35 @@ namespace transport_catalogue {
 			RenderStopLabels(projector);
 		}
 
-		void MapRenderer::InitNotEmptyBusesAndStops(std::vector<domain::Bus*> buses) {
-			std::sort(buses.begin(), buses.end(), [](const domain::Bus* lhs, const domain::Bus* rhs) {return std::lexicographical_compare(lhs->name_.begin(), lhs->name_.end(), rhs->name_.begin(), rhs->name_.end()); });
-			for (auto* bus : buses) {
-				if (!bus->stops_.empty()) {
+		void MapRenderer::InitNotEmptyBusesAndStops() {
+			std::vector<uint8_t> is_stop_used(catalogue_.GetStops().size(), 0);
+			for (domain::BusId bus_id = 0; bus_id < catalogue_.GetBuses().size(); ++bus_id) {
+				const domain::Bus* bus = catalogue_.GetBus(bus_id);
+				if (!bus->stop_ids_.empty()) {
 					buses_.push_back(bus);
-					for (auto* stop : bus->stops_) {
-						stops_.insert(stop);
+					for (domain::StopId stop_id : bus->stop_ids_) {
+						is_stop_used[stop_id] = 1;
 					}
 				}
 			}
+			std::sort(buses_.begin(), buses_.end(), [](const domain::Bus* lhs, const domain::Bus* rhs) {return std::lexicographical_compare(lhs->name_.begin(), lhs->name_.end(), rhs->name_.begin(), rhs->name_.end()); });
+
+			for (domain::StopId stop_id = 0; stop_id < is_stop_used.size(); ++stop_id) {
+				if (is_stop_used[stop_id]) {
+					stops_.push_back(stop_id);
+				}
+			}
+			std::sort(stops_.begin(), stops_.end(), [this](domain::StopId lhs, domain::StopId rhs) {
+				const std::string& lhs_name = catalogue_.GetStop(lhs)->name_;
+				const std::string& rhs_name = catalogue_.GetStop(rhs)->name_;
+				return std::lexicographical_compare(lhs_name.begin(), lhs_name.end(), rhs_name.begin(), rhs_name.end());
+			});
 		}
 
 		std::vector<geo::Coordinates> MapRenderer::GetAllCoords() {
 			std::vector<geo::Coordinates> coords;
-			for (auto* stop : stops_) {
-				coords.push_back(stop->coords_);
+			for (domain::StopId stop_id : stops_) {
+				coords.push_back(catalogue_.GetStopCoordinates(stop_id));
 			}
 			return coords;
 		}
@@ -144,12 +157,13 @@ namespace transport_catalogue {
 		void MapRenderer::RenderBusLines(sphere_projector::SphereProjector& projector) {
 			for (size_t i = 0u; i < buses_.size(); i++) {
 				svg::Polyline line = CreateBusLine(i);
-				for (auto* stop : buses_[i]->stops_) {
-					line.AddPoint(projector(stop->coords_));
+				const auto& stop_ids = buses_[i]->stop_ids_;
+				for (domain::StopId stop_id : stop_ids) {
+					line.AddPoint(Project(projector, stop_id));
 				}
 				if (buses_[i]->route_type_ == domain::RouteType::DIRECT) {
-					for (int j = buses_[i]->stops_.size() - 2; j >= 0; j--) {
-						line.AddPoint(projector(buses_[i]->stops_[j]->coords_));
+					for (int j = stop_ids.size() - 2; j >= 0; j--) {
+						line.AddPoint(Project(projector, stop_ids[j]));
 					}
 				}
 				Add(line);
@@ -157,30 +171,31 @@ namespace transport_catalogue {
 		}
 
 		void MapRenderer::RenderStops(sphere_projector::SphereProjector& projector) {
-			for (auto* stop : stops_) {
+			for (domain::StopId stop_id : stops_) {
 				svg::Circle circle = CreateStopCircle();
-				circle.SetCenter(projector(stop->coords_));
+				circle.SetCenter(Project(projector, stop_id));
 				Add(circle);
 			}
 		}
 
 		void MapRenderer::RenderBusLabels(sphere_projector::SphereProjector& projector) {
 			for (size_t i = 0; i < buses_.size(); i++) {
-				auto& stops = buses_[i]->stops_;
-				Add(CreateBusLabelUnderlayer().SetPosition(projector(stops[0]->coords_)).SetData(buses_[i]->name_));
-				Add(CreateBusLabel(i).SetPosition(projector(stops[0]->coords_)).SetData(buses_[i]->name_));
-				if (buses_[i]->route_type_ != domain::RouteType::ROUND && stops.front() != stops.back()) {
-					Add(CreateBusLabelUnderlayer().SetPosition(projector(stops.back()->coords_)).SetData(buses_[i]->name_));
-					Add(CreateBusLabel(i).SetPosition(projector(stops.back()->coords_)).SetData(buses_[i]->name_));
+				auto& stop_ids = buses_[i]->stop_ids_;
+				Add(CreateBusLabelUnderlayer().SetPosition(Project(projector, stop_ids[0])).SetData(buses_[i]->name_));
+				Add(CreateBusLabel(i).SetPosition(Project(projector, stop_ids[0])).SetData(buses_[i]->name_));
+				if (buses_[i]->route_type_ != domain::RouteType::ROUND && stop_ids.front() != stop_ids.back()) {
+					Add(CreateBusLabelUnderlayer().SetPosition(Project(projector, stop_ids.back())).SetData(buses_[i]->name_));
+					Add(CreateBusLabel(i).SetPosition(Project(projector, stop_ids.back())).SetData(buses_[i]->name_));
 				}
 			}
 		}
 
 		void MapRenderer::RenderStopLabels(sphere_projector::SphereProjector& projector) {
-			for (auto* stop : stops_) {
+			for (domain::StopId stop_id : stops_) {
 				svg::Text text = CreateStopLabel();
-				Add(CreateStopLabelUnderlayer().SetPosition(projector(stop->coords_)).SetData(stop->name_));
-				Add(CreateStopLabel().SetPosition(projector(stop->coords_)).SetData(stop->name_));
+				const std::string& name = catalogue_.GetStop(stop_id)->name_;
+				Add(CreateStopLabelUnderlayer().SetPosition(Project(projector, stop_id)).SetData(name));
+				Add(CreateStopLabel().SetPosition(Project(projector, stop_id)).SetData(name));
 			}
 		}
 	} //--------------- namespace map_renderer -------------
@@ -11,6 +11,7 @@
 
 #include "domain.h"
 #include "svg.h"
+#include "transport_catalogue.h"
 
 
 
@@ -132,26 +133,26 @@ namespace transport_catalogue {
 
         class MapRenderer : public svg::Document, private MapRendererBase {
         public:
-            MapRenderer(MapRenderSettings&& settings, std::vector<domain::Bus*> buses);
+            // Draws the buses of `catalogue` that have stops, and those stops
+            MapRenderer(MapRenderSettings&& settings, const TransportCatalogue& catalogue);
         private:
             std::vector<geo::Coordinates> GetAllCoords();
 
-            void InitNotEmptyBusesAndStops(std::vector<domain::Bus*> buses);
+            void InitNotEmptyBusesAndStops();
+
+            svg::Point Project(const sphere_projector::SphereProjector& projector, domain::StopId stop_id) const {
+                return projector(catalogue_.GetStopCoordinates(stop_id));
+            }
 
             void RenderBusLines(sphere_projector::SphereProjector& projector);
             void RenderStops(sphere_projector::SphereProjector& projector);
             void RenderBusLabels(sphere_projector::SphereProjector& projector);
             void RenderStopLabels(sphere_projector::SphereProjector& projector);
 
-            struct StopPtrComparator {
-                bool operator()(const domain::Stop* lhs, const domain::Stop* rhs) const {
-                    return std::lexicographical_compare(lhs->name_.begin(), lhs->name_.end(),
-                        rhs->name_.begin(), rhs->name_.end());
-                }
-            };
-
-            std::set<domain::Stop*, StopPtrComparator> stops_;
-            std::vector<domain::Bus*> buses_;
+            const TransportCatalogue& catalogue_;
+            // Sorted by name
+            std::vector<domain::StopId> stops_;
+            std::vector<const domain::Bus*> buses_;
         };
 
 
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define GRAPH_MIN_PLUS_X86_KERNELS 1
+#include <immintrin.h>
+#else
+#define GRAPH_MIN_PLUS_X86_KERNELS 0
+#endif
+
+namespace graph {
+
+    namespace detail {
+
+        // Min-plus update of one row of the all-pairs table over columns [begin, end):
+        // weights[j] = min(weights[j], weight_from + row_to_weights[j]). An improved cell takes the
+        // predecessor edge of `row_to`, or `prev_edge_from` where `row_to` has none (`no_edge`).
+        // `row_to` may alias the updated row. Cell types without infinity mark unreachable cells with
+        // max(), and those never take part in a sum.
+        template <typename CellWeight, typename CellEdgeId>
+        using RelaxRowKernel = void (*)(CellWeight* weights, CellEdgeId* prev_edges, CellWeight weight_from,
+            CellEdgeId prev_edge_from, const CellWeight* row_to_weights, const CellEdgeId* row_to_prev_edges,
+            CellEdgeId no_edge, size_t begin, size_t end);
+
+        template <typename CellWeight, typename CellEdgeId>
+        void RelaxRowScalar(CellWeight* weights, CellEdgeId* prev_edges, CellWeight weight_from,
+            CellEdgeId prev_edge_from, const CellWeight* row_to_weights, const CellEdgeId* row_to_prev_edges,
+            CellEdgeId no_edge, size_t begin, size_t end) {
+            for (size_t vertex_to = begin; vertex_to < end; ++vertex_to) {
+                if constexpr (!std::numeric_limits<CellWeight>::has_infinity) {
+                    if (row_to_weights[vertex_to] == std::numeric_limits<CellWeight>::max()) {
+                        continue;
+                    }
+                }
+                const CellWeight candidate_weight = weight_from + row_to_weights[vertex_to];
+                if (candidate_weight < weights[vertex_to]) {
+                    weights[vertex_to] = candidate_weight;
+                    prev_edges[vertex_to] = row_to_prev_edges[vertex_to] != no_edge
+                        ? row_to_prev_edges[vertex_to] : prev_edge_from;
+                }
+            }
+        }
+
+#if GRAPH_MIN_PLUS_X86_KERNELS
+
+        // The floating-point kernels compare with _CMP_LT_OQ, false on NaN like the scalar `<`, and add
+        // without contraction, so all kernels produce the scalar kernel's tables bit for bit. Stores are
+        // masked: cells that don't improve are never written. The tail goes through the scalar kernel.
+
+        __attribute__((target("avx2")))
+        inline void RelaxRowAvx2(double* weights, uint32_t* prev_edges, double weight_from, uint32_t prev_edge_from,
+            const double* row_to_weights, const uint32_t* row_to_prev_edges, uint32_t no_edge, size_t begin, size_t end) {
+            const __m256d from = _mm256_set1_pd(weight_from);
+            const __m128i fallback = _mm_set1_epi32(static_cast<int>(prev_edge_from));
+            const __m128i none = _mm_set1_epi32(static_cast<int>(no_edge));
+            // Low dwords of the four 64-bit compare lanes
+            const __m256i narrow = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+            size_t vertex_to = begin;
+            for (; vertex_to + 4 <= end; vertex_to += 4) {
+                const __m256d candidate = _mm256_add_pd(from, _mm256_loadu_pd(row_to_weights + vertex_to));
+                const __m256d is_better = _mm256_cmp_pd(candidate, _mm256_loadu_pd(weights + vertex_to), _CMP_LT_OQ);
+                if (_mm256_movemask_pd(is_better) == 0) {
+                    continue;
+                }
+                _mm256_maskstore_pd(weights + vertex_to, _mm256_castpd_si256(is_better), candidate);
+
+                const __m128i row_to_prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row_to_prev_edges + vertex_to));
+                const __m128i prev = _mm_blendv_epi8(row_to_prev, fallback, _mm_cmpeq_epi32(row_to_prev, none));
+                const __m128i is_better_narrow = _mm256_castsi256_si128(
+                    _mm256_permutevar8x32_epi32(_mm256_castpd_si256(is_better), narrow));
+                _mm_maskstore_epi32(reinterpret_cast<int*>(prev_edges + vertex_to), is_better_narrow, prev);
+            }
+            RelaxRowScalar(weights, prev_edges, weight_from, prev_edge_from, row_to_weights, row_to_prev_edges,
+                no_edge, vertex_to, end);
+        }
+
+        __attribute__((target("avx2")))
+        inline void RelaxRowAvx2(float* weights, uint32_t* prev_edges, float weight_from, uint32_t prev_edge_from,
+            const float* row_to_weights, const uint32_t* row_to_prev_edges, uint32_t no_edge, size_t begin, size_t end) {
+            const __m256 from = _mm256_set1_ps(weight_from);
+            const __m256i fallback = _mm256_set1_epi32(static_cast<int>(prev_edge_from));
+            const __m256i none = _mm256_set1_epi32(static_cast<int>(no_edge));
+            size_t vertex_to = begin;
+            for (; vertex_to + 8 <= end; vertex_to += 8) {
+                const __m256 candidate = _mm256_add_ps(from, _mm256_loadu_ps(row_to_weights + vertex_to));
+                const __m256 is_better = _mm256_cmp_ps(candidate, _mm256_loadu_ps(weights + vertex_to), _CMP_LT_OQ);
+                if (_mm256_movemask_ps(is_better) == 0) {
+                    continue;
+                }
+                _mm256_maskstore_ps(weights + vertex_to, _mm256_castps_si256(is_better), candidate);
+
+                const __m256i row_to_prev = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row_to_prev_edges + vertex_to));
+                const __m256i prev = _mm256_blendv_epi8(row_to_prev, fallback, _mm256_cmpeq_epi32(row_to_prev, none));
+                _mm256_maskstore_epi32(reinterpret_cast<int*>(prev_edges + vertex_to), _mm256_castps_si256(is_better), prev);
+            }
+            RelaxRowScalar(weights, prev_edges, weight_from, prev_edge_from, row_to_weights, row_to_prev_edges,
+                no_edge, vertex_to, end);
+        }
+
+        __attribute__((target("avx2")))
+        inline void RelaxRowAvx2(int32_t* weights, uint32_t* prev_edges, int32_t weight_from, uint32_t prev_edge_from,
+            const int32_t* row_to_weights, const uint32_t* row_to_prev_edges, uint32_t no_edge, size_t begin, size_t end) {
+            const __m256i from = _mm256_set1_epi32(weight_from);
+            const __m256i unreachable = _mm256_set1_epi32(std::numeric_limits<int32_t>::max());
+            const __m256i fallback = _mm256_set1_epi32(static_cast<int>(prev_edge_from));
+            const __m256i none = _mm256_set1_epi32(static_cast<int>(no_edge));
+            size_t vertex_to = begin;
+            for (; vertex_to + 8 <= end; vertex_to += 8) {
+                const __m256i row_to = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row_to_weights + vertex_to));
+                // The sum wraps for unreachable cells, which the mask drops
+                const __m256i candidate = _mm256_add_epi32(from, row_to);
+                const __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + vertex_to));
+                const __m256i is_better = _mm256_andnot_si256(_mm256_cmpeq_epi32(row_to, unreachable),
+                    _mm256_cmpgt_epi32(current, candidate));
+                if (_mm256_testz_si256(is_better, is_better)) {
+                    continue;
+                }
+                _mm256_maskstore_epi32(reinterpret_cast<int*>(weights + vertex_to), is_better, candidate);
+
+                const __m256i row_to_prev = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row_to_prev_edges + vertex_to));
+                const __m256i prev = _mm256_blendv_epi8(row_to_prev, fallback, _mm256_cmpeq_epi32(row_to_prev, none));
+                _mm256_maskstore_epi32(reinterpret_cast<int*>(prev_edges + vertex_to), is_better, prev);
+            }
+            RelaxRowScalar(weights, prev_edges, weight_from, prev_edge_from, row_to_weights, row_to_prev_edges,
+                no_edge, vertex_to, end);
+        }
+
+        __attribute__((target("avx512f,avx512vl")))
+        inline void RelaxRowAvx512(double* weights, uint32_t* prev_edges, double weight_from, uint32_t prev_edge_from,
+            const double* row_to_weights, const uint32_t* row_to_prev_edges, uint32_t no_edge, size_t begin, size_t end) {
+            const __m512d from = _mm512_set1_pd(weight_from);
+            const __m256i fallback = _mm256_set1_epi32(static_cast<int>(prev_edge_from));
+            const __m256i none = _mm256_set1_epi32(static_cast<int>(no_edge));
+            size_t vertex_to = begin;
+            for (; vertex_to + 8 <= end; vertex_to += 8) {
+                const __m512d candidate = _mm512_add_pd(from, _mm512_loadu_pd(row_to_weights + vertex_to));
+                const __mmask8 is_better = _mm512_cmp_pd_mask(candidate, _mm512_loadu_pd(weights + vertex_to), _CMP_LT_OQ);
+                if (is_better == 0) {
+                    continue;
+                }
+                _mm512_mask_storeu_pd(weights + vertex_to, is_better, candidate);
+
+                const __m256i row_to_prev = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row_to_prev_edges + vertex_to));
+                const __m256i prev = _mm256_mask_blend_epi32(_mm256_cmpeq_epi32_mask(row_to_prev, none), row_to_prev, fallback);
+                _mm256_mask_storeu_epi32(prev_edges + vertex_to, is_better, prev);
+            }
+            RelaxRowScalar(weights, prev_edges, weight_from, prev_edge_from, row_to_weights, row_to_prev_edges,
+                no_edge, vertex_to, end);
+        }
+
+        __attribute__((target("avx512f")))
+        inline void RelaxRowAvx512(float* weights, uint32_t* prev_edges, float weight_from, uint32_t prev_edge_from,
+            const float* row_to_weights, const uint32_t* row_to_prev_edges, uint32_t no_edge, size_t begin, size_t end) {
+            const __m512 from = _mm512_set1_ps(weight_from);
+            const __m512i fallback = _mm512_set1_epi32(static_cast<int>(prev_edge_from));
+            const __m512i none = _mm512_set1_epi32(static_cast<int>(no_edge));
+            size_t vertex_to = begin;
+            for (; vertex_to + 16 <= end; vertex_to += 16) {
+                const __m512 candidate = _mm512_add_ps(from, _mm512_loadu_ps(row_to_weights + vertex_to));
+                const __mmask16 is_better = _mm512_cmp_ps_mask(candidate, _mm512_loadu_ps(weights + vertex_to), _CMP_LT_OQ);
+                if (is_better == 0) {
+                    continue;
+                }
+                _mm512_mask_storeu_ps(weights + vertex_to, is_better, candidate);
+
+                const __m512i row_to_prev = _mm512_loadu_si512(row_to_prev_edges + vertex_to);
+                const __m512i prev = _mm512_mask_blend_epi32(_mm512_cmpeq_epi32_mask(row_to_prev, none), row_to_prev, fallback);
+                _mm512_mask_storeu_epi32(prev_edges + vertex_to, is_better, prev);
+            }
+            RelaxRowScalar(weights, prev_edges, weight_from, prev_edge_from, row_to_weights, row_to_prev_edges,
+                no_edge, vertex_to, end);
+        }
+
+        __attribute__((target("avx512f")))
+        inline void RelaxRowAvx512(int32_t* weights, uint32_t* prev_edges, int32_t weight_from, uint32_t prev_edge_from,
+            const int32_t* row_to_weights, const uint32_t* row_to_prev_edges, uint32_t no_edge, size_t begin, size_t end) {
+            const __m512i from = _mm512_set1_epi32(weight_from);
+            const __m512i unreachable = _mm512_set1_epi32(std::numeric_limits<int32_t>::max());
+            const __m512i fallback = _mm512_set1_epi32(static_cast<int>(prev_edge_from));
+            const __m512i none = _mm512_set1_epi32(static_cast<int>(no_edge));
+            size_t vertex_to = begin;
+            for (; vertex_to + 16 <= end; vertex_to += 16) {
+                const __m512i row_to = _mm512_loadu_si512(row_to_weights + vertex_to);
+                const __m512i candidate = _mm512_add_epi32(from, row_to);
+                const __mmask16 is_better = _mm512_mask_cmplt_epi32_mask(_mm512_cmpneq_epi32_mask(row_to, unreachable),
+                    candidate, _mm512_loadu_si512(weights + vertex_to));
+                if (is_better == 0) {
+                    continue;
+                }
+                _mm512_mask_storeu_epi32(weights + vertex_to, is_better, candidate);
+
+                const __m512i row_to_prev = _mm512_loadu_si512(row_to_prev_edges + vertex_to);
+                const __m512i prev = _mm512_mask_blend_epi32(_mm512_cmpeq_epi32_mask(row_to_prev, none), row_to_prev, fallback);
+                _mm512_mask_storeu_epi32(prev_edges + vertex_to, is_better, prev);
+            }
+            RelaxRowScalar(weights, prev_edges, weight_from, prev_edge_from, row_to_weights, row_to_prev_edges,
+                no_edge, vertex_to, end);
+        }
+
+#endif
+
+        // Widest kernel the running CPU supports for these cell types, the scalar one for the rest
+        template <typename CellWeight, typename CellEdgeId>
+        RelaxRowKernel<CellWeight, CellEdgeId> SelectRelaxRowKernel() {
+#if GRAPH_MIN_PLUS_X86_KERNELS
+            if constexpr ((std::is_same_v<CellWeight, double> || std::is_same_v<CellWeight, float>
+                || std::is_same_v<CellWeight, int32_t>) && std::is_same_v<CellEdgeId, uint32_t>) {
+                if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")) {
+                    return static_cast<RelaxRowKernel<CellWeight, CellEdgeId>>(RelaxRowAvx512);
+                }
+                if (__builtin_cpu_supports("avx2")) {
+                    return static_cast<RelaxRowKernel<CellWeight, CellEdgeId>>(RelaxRowAvx2);
+                }
+            }
+#endif
+            return RelaxRowScalar<CellWeight, CellEdgeId>;
+        }
+
+    }  // namespace detail
+
+}  // namespace graph
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+    // Number of workers to use when the caller asks for 0
+    inline size_t GetDefaultThreadCount() {
+        return std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    namespace detail {
+
+        // Fixed set of worker threads running queued tasks in FIFO order. Threads are started
+        // once and reused by every ForEachIndex call instead of being spawned per call.
+        class ThreadPool {
+        public:
+            explicit ThreadPool(size_t worker_count) {
+                workers_.reserve(worker_count);
+                for (size_t i = 0; i < worker_count; ++i) {
+                    workers_.emplace_back([this]() {
+                        RunWorker();
+                    });
+                }
+            }
+
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+
+            ~ThreadPool() {
+                {
+                    std::lock_guard lock(mutex_);
+                    is_stopping_ = true;
+                }
+                has_tasks_.notify_all();
+                for (std::thread& worker : workers_) {
+                    worker.join();
+                }
+            }
+
+            size_t GetWorkerCount() const {
+                return workers_.size();
+            }
+
+            void Submit(std::function<void()> task) {
+                {
+                    std::lock_guard lock(mutex_);
+                    tasks_.push_back(std::move(task));
+                }
+                has_tasks_.notify_one();
+            }
+
+            // True on the pool's own threads; a task that blocks there waiting for other
+            // tasks could starve the pool, so nested parallel loops run inline instead
+            static bool IsWorkerThread() {
+                return is_worker_thread_;
+            }
+
+        private:
+            void RunWorker() {
+                is_worker_thread_ = true;
+                while (true) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock lock(mutex_);
+                        has_tasks_.wait(lock, [this]() {
+                            return is_stopping_ || !tasks_.empty();
+                        });
+                        if (tasks_.empty()) {
+                            return;
+                        }
+                        task = std::move(tasks_.front());
+                        tasks_.pop_front();
+                    }
+                    task();
+                }
+            }
+
+            static inline thread_local bool is_worker_thread_ = false;
+
+            std::mutex mutex_;
+            std::condition_variable has_tasks_;
+            std::deque<std::function<void()>> tasks_;
+            bool is_stopping_ = false;
+            std::vector<std::thread> workers_;
+        };
+
+        // Shared pool, started on first use. The calling thread always takes part in the work,
+        // so one thread fewer than the default count is enough
+        inline ThreadPool& GetThreadPool() {
+            static ThreadPool pool(GetDefaultThreadCount() - 1);
+            return pool;
+        }
+
+    }  // namespace detail
+
+    // Calls `func(index)` for every index in [0, count) on up to `thread_count` threads
+    // (the calling thread included, the rest taken from the shared pool, so the count is capped
+    // by its size). Indices are handed out dynamically, so uneven tasks balance out; the first
+    // exception thrown by a task is rethrown after all workers finish.
+    template <typename Func>
+    void ForEachIndex(size_t count, size_t thread_count, Func func) {
+        if (thread_count == 0) {
+            thread_count = GetDefaultThreadCount();
+        }
+        thread_count = std::min(thread_count, count);
+        if (thread_count > 1) {
+            thread_count = detail::ThreadPool::IsWorkerThread()
+                ? 1
+                : std::min(thread_count, detail::GetThreadPool().GetWorkerCount() + 1);
+        }
+        if (thread_count <= 1) {
+            for (size_t index = 0; index < count; ++index) {
+                func(index);
+            }
+            return;
+        }
+
+        std::atomic<size_t> next_index{ 0 };
+        std::exception_ptr exception;
+        std::mutex exception_mutex;
+        const std::function<void()> worker = [&]() {
+            for (size_t index = next_index++; index < count; index = next_index++) {
+                try {
+                    func(index);
+                }
+                catch (...) {
+                    std::lock_guard lock(exception_mutex);
+                    if (!exception) {
+                        exception = std::current_exception();
+                    }
+                }
+            }
+        };
+
+        // Helpers may still be queued behind other work when the indices run out; once the call
+        // is closed they return without touching `worker`, so only started ones are waited for
+        struct Helpers {
+            std::mutex mutex;
+            std::condition_variable all_done;
+            size_t running = 0;
+            bool is_closed = false;
+        };
+        const auto helpers = std::make_shared<Helpers>();
+        for (size_t i = 1; i < thread_count; ++i) {
+            detail::GetThreadPool().Submit([helpers, &worker]() {
+                {
+                    std::lock_guard lock(helpers->mutex);
+                    if (helpers->is_closed) {
+                        return;
+                    }
+                    ++helpers->running;
+                }
+                worker();
+                std::lock_guard lock(helpers->mutex);
+                if (--helpers->running == 0) {
+                    helpers->all_done.notify_all();
+                }
+            });
+        }
+        worker();
+        {
+            std::unique_lock lock(helpers->mutex);
+            helpers->is_closed = true;
+            helpers->all_done.wait(lock, [&helpers]() {
+                return helpers->running == 0;
+            });
+        }
+
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+
+}  // namespace parallel
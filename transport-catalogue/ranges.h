@@ -52,12 +52,13 @@ namespace ranges {
         }
     };
 
-    inline auto AsBusRangeDirect(transport_catalogue::domain::Bus* bus) {
-        return BusRange{ bus->stops_.begin(), bus->stops_.end(), bus };
+    // Ranges of the stop ids of a bus
+    inline auto AsBusRangeDirect(const transport_catalogue::domain::Bus* bus) {
+        return BusRange{ bus->stop_ids_.begin(), bus->stop_ids_.end(), bus };
     }
 
-    inline auto AsBusRangeReversed(transport_catalogue::domain::Bus* bus) {
-        return BusRange{ bus->stops_.rbegin(), bus->stops_.rend(), bus };
+    inline auto AsBusRangeReversed(const transport_catalogue::domain::Bus* bus) {
+        return BusRange{ bus->stop_ids_.rbegin(), bus->stop_ids_.rend(), bus };
     }
 
 }  // namespace ranges
\ No newline at end of file
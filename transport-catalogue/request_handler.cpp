@@ -2,14 +2,18 @@
 
 #include <algorithm>
 #include <iostream>
+#include <limits>
 #include <sstream>
+#include <stdexcept>
 #include <unordered_map>
 
 
 #include "domain.h"
 #include "json_reader.h"
 #include "map_renderer.h"
+#include "parallel.h"
 #include "router.h"
+#include "router_serialization.h"
 #include "transport_catalogue.h"
 #include "transport_router.h"
 
@@ -98,11 +102,154 @@ namespace transport_catalogue {
 			ApplyStopRequests();
 			ApplyBusRequests();
 			ApplyRoutingSettings();
+			db_.UpdateBusStats();
 		}
 
-		void RequestHandler::Router() {
-			graph_ = std::make_unique<transport_graph::TransportGraph>(transport_graph::TransportGraph(db_));
-			router_ = std::make_unique<transport_graph::TransportRouter>(transport_graph::TransportRouter(*graph_));
+		void RequestHandler::Router(transport_graph::RouterType type) {
+			const auto& routing_settings = reader_.GetRoutingSettings();
+			size_t route_cache_bytes = transport_graph::TransportRouter::DEFAULT_ROUTE_CACHE_BYTES;
+			if (routing_settings.count("route_cache_bytes") > 0) {
+				// Converting a double out of the size_t range is undefined: negative and NaN sizes
+				// disable the cache, sizes too large for size_t are capped
+				const double requested_bytes = routing_settings.at("route_cache_bytes");
+				if (!(requested_bytes > 0)) {
+					route_cache_bytes = 0;
+				}
+				else if (requested_bytes >= static_cast<double>(std::numeric_limits<size_t>::max())) {
+					route_cache_bytes = std::numeric_limits<size_t>::max();
+				}
+				else {
+					route_cache_bytes = static_cast<size_t>(requested_bytes);
+				}
+			}
+
+			if (type == transport_graph::RouterType::BUS_LINES) {
+				graph_.reset();
+				router_ = std::make_unique<transport_graph::TransportRouter>(db_, route_cache_bytes);
+				return;
+			}
+
+			// A new router starts with an empty route cache, so rebuilding the graph invalidates it
+			const auto& serialization_settings = reader_.GetSerializationSettings();
+			const bool is_planned = type == transport_graph::RouterType::SOURCE_TREES
+				|| (type == transport_graph::RouterType::ALL_PAIRS && serialization_settings.count("file") == 0);
+			if (is_planned) {
+				graph_ = std::make_shared<const transport_graph::TransportGraph>(db_);
+				std::vector<graph::VertexId> origins = GetBatchRouteOrigins(*graph_);
+				// A tree per origin beats the V x V tables until the origins cover a good part of the graph
+				if (type == transport_graph::RouterType::SOURCE_TREES
+					|| origins.size() * PLANNED_VERTICES_PER_ORIGIN < graph_->GetGraph().GetVertexCount()) {
+					auto engine = std::make_unique<graph::SourceTreesRouter<transport_graph::TransportTime>>(graph_->GetGraph(),
+						std::move(origins), parallel::GetDefaultThreadCount());
+					router_ = std::make_unique<transport_graph::TransportRouter>(graph_, transport_graph::RouterType::SOURCE_TREES,
+						std::move(engine), route_cache_bytes);
+				}
+				else {
+					router_ = std::make_unique<transport_graph::TransportRouter>(graph_, type, route_cache_bytes);
+				}
+				return;
+			}
+			if (type != transport_graph::RouterType::ALL_PAIRS) {
+				graph_ = std::make_shared<const transport_graph::TransportGraph>(db_);
+				router_ = std::make_unique<transport_graph::TransportRouter>(graph_, type, route_cache_bytes);
+				return;
+			}
+
+			// Warm start: reuse the tables saved by an earlier run over the same input, else build and save them
+			namespace serialization = transport_graph::serialization;
+			const std::string& path = serialization_settings.at("file")->AsString();
+			const uint64_t key = serialization::ComputeRoutesKey(reader_.GetBaseRequestsNode(), reader_.GetRoutingSettingsNode());
+
+			if (auto saved = serialization::LoadRoutes(path, key, db_)) {
+				graph_ = std::move(saved->graph);
+				router_ = std::make_unique<transport_graph::TransportRouter>(graph_, type, std::move(saved->router), route_cache_bytes);
+				return;
+			}
+
+			graph_ = std::make_shared<const transport_graph::TransportGraph>(db_);
+			auto engine = std::make_unique<serialization::AllPairsRouter>(graph_->GetGraph(), parallel::GetDefaultThreadCount());
+			// Saving is best-effort: this run serves routes from the fresh tables either way
+			if (!serialization::SaveRoutes(path, key, *graph_, *engine)) {
+				std::cerr << "Can't save routes to " << path << ", the next run will rebuild them" << std::endl;
+			}
+			router_ = std::make_unique<transport_graph::TransportRouter>(graph_, type, std::move(engine), route_cache_bytes);
+		}
+
+		std::vector<graph::VertexId> RequestHandler::GetBatchRouteOrigins(const transport_graph::TransportGraph& graph) const {
+			const auto add_origin = [&](const std::string& stopname, std::vector<graph::VertexId>& origins) {
+				// Unknown stops are reported by the request itself, stops served by no bus have no vertex
+				const auto stop_it = db_.GetStops().find(stopname);
+				if (stop_it == db_.GetStops().end()) {
+					return;
+				}
+				if (const transport_graph::VertexIdLoop* vertex_id = graph.FindVertexId(stop_it->second)) {
+					origins.push_back(vertex_id->transfer_id);
+				}
+			};
+
+			std::vector<graph::VertexId> origins;
+			for (const json::Node* request : reader_.GetStatRequests()) {
+				const json::Dict& request_data = request->AsDict();
+				const std::string& request_type = request_data.at("type").AsString();
+				if (request_type == "Route") {
+					add_origin(request_data.at("from").AsString(), origins);
+				}
+				else if (request_type == "Matrix") {
+					for (const json::Node& stopname : request_data.at("from").AsArray()) {
+						add_origin(stopname.AsString(), origins);
+					}
+				}
+			}
+			std::sort(origins.begin(), origins.end());
+			origins.erase(std::unique(origins.begin(), origins.end()), origins.end());
+			return origins;
+		}
+
+		void RequestHandler::SetDistance(std::string_view stopname1, std::string_view stopname2, double distance) {
+			const domain::Stop* stop1 = db_.GetStopByName(stopname1);
+			const domain::Stop* stop2 = db_.GetStopByName(stopname2);
+			db_.SetDistance(stopname1, stopname2, distance);
+			db_.UpdateBusStats();
+
+			// Buses riding the road in either direction
+			std::vector<domain::Bus*> changed_buses;
+			for (std::string_view busname : db_.GetBusnamesForStop(stopname1)) {
+				domain::Bus* bus = db_.GetBuses().at(busname);
+				const auto& stop_ids = bus->stop_ids_;
+				for (size_t i = 1; i < stop_ids.size(); ++i) {
+					if ((stop_ids[i - 1] == stop1->id_ && stop_ids[i] == stop2->id_) || (stop_ids[i - 1] == stop2->id_ && stop_ids[i] == stop1->id_)) {
+						changed_buses.push_back(bus);
+						break;
+					}
+				}
+			}
+			UpdateRouter(changed_buses);
+		}
+
+		void RequestHandler::AddBus(const std::string& busname, const std::vector<std::string>& stopnames, bool is_roundtrip) {
+			if (db_.GetBuses().count(busname) > 0) {
+				throw std::invalid_argument("Bus " + busname + " already exists");
+			}
+			db_.AddBus(busname);
+			db_.SetBusRouteType(busname, IntToRouteType((int)is_roundtrip));
+			for (const std::string& stopname : stopnames) {
+				db_.AddStopForBus(busname, stopname);
+			}
+			db_.UpdateBusStats();
+			UpdateRouter({ db_.GetBuses().at(busname) });
+		}
+
+		void RequestHandler::UpdateRouter(const std::vector<domain::Bus*>& changed_buses) {
+			if (router_ == nullptr) {
+				return;
+			}
+			// The line model reads the catalogue and is cheap to build
+			if (graph_ == nullptr) {
+				Router(transport_graph::RouterType::BUS_LINES);
+				return;
+			}
+			graph_ = std::make_shared<const transport_graph::TransportGraph>(*graph_, changed_buses);
+			router_ = router_->Update(graph_);
 		}
 
 		void RequestHandler::ApplyStopRequests() {
@@ -163,6 +310,12 @@ namespace transport_catalogue {
 				else if (request_type == "Route") {
 					ApplySingleRouteRequest(builder, request_data);
 				}
+				else if (request_type == "Matrix") {
+					ApplySingleMatrixRequest(builder, request_data);
+				}
+				else if (request_type == "Isochrone") {
+					ApplySingleIsochroneRequest(builder, request_data);
+				}
 			}
 
 			builder.EndArray();
@@ -192,15 +345,12 @@ namespace transport_catalogue {
 			const std::string name = request_data.at("name").AsString();
 
 			try {
-				double curvature = db_.GetRouteCurvature(name);
-				double route_length = db_.GetRouteLength(name);
-				int stop_count = db_.GetStopCount(name);
-				int unique_stop_count = db_.GetUniqueStopsCount(name);
+				const BusStats stats = db_.GetBusStats(name);
 
-				builder.Key("curvature").Value(curvature);
-				builder.Key("route_length").Value(route_length);
-				builder.Key("stop_count").Value(stop_count);
-				builder.Key("unique_stop_count").Value(unique_stop_count);
+				builder.Key("curvature").Value(stats.curvature);
+				builder.Key("route_length").Value(stats.route_length);
+				builder.Key("stop_count").Value(static_cast<int>(stats.stop_count));
+				builder.Key("unique_stop_count").Value(static_cast<int>(stats.unique_stop_count));
 			}
 			catch (const std::out_of_range&) {
 				builder.Key("error_message").Value("not found");
@@ -235,19 +385,19 @@ namespace transport_catalogue {
 					builder.StartDict();
 					if (data.bus == nullptr) {
 						builder.Key("stop_name").Value(data.stop_from->name_);
-						builder.Key("time").Value(data.time);
+						builder.Key("time").Value(transport_graph::ToMinutes(data.time));
 						builder.Key("type").Value("Wait");
 					}
 					else {
 						builder.Key("bus").Value(data.bus->name_);
 						builder.Key("span_count").Value(data.stop_count);
-						builder.Key("time").Value(data.time);
+						builder.Key("time").Value(transport_graph::ToMinutes(data.time));
 						builder.Key("type").Value("Bus");
 					}
 					builder.EndDict();
 				}
 				builder.EndArray();
-				builder.Key("total_time").Value(route_data.value().time);
+				builder.Key("total_time").Value(transport_graph::ToMinutes(route_data.value().time));
 			}
 			else {
 				builder.Key("error_message").Value("not found");
@@ -255,13 +405,72 @@ namespace transport_catalogue {
 			builder.EndDict();
 		}
 			
+		void RequestHandler::ApplySingleMatrixRequest(json::Builder& builder, const json::Dict& request_data) {
+			if (router_ == nullptr) {
+				throw std::logic_error("");
+			}
+			builder.StartDict().Key("request_id").Value(request_data.at("id").AsInt());
+
+			const auto get_stops = [this](const json::Array& names) {
+				std::vector<const Stop*> stops;
+				stops.reserve(names.size());
+				for (const json::Node& name : names) {
+					stops.push_back(db_.GetStopByName(name.AsString()));
+				}
+				return stops;
+			};
+
+			try {
+				const std::vector<const Stop*> origins = get_stops(request_data.at("from").AsArray());
+				const std::vector<const Stop*> destinations = get_stops(request_data.at("to").AsArray());
+
+				json::Array rows;
+				rows.reserve(origins.size());
+				for (const auto& row_times : router_->GetTravelTimes(origins, destinations)) {
+					json::Array row;
+					row.reserve(row_times.size());
+					for (const auto& time : row_times) {
+						row.push_back(time ? json::Node(transport_graph::ToMinutes(*time)) : json::Node(nullptr));
+					}
+					rows.push_back(std::move(row));
+				}
+				builder.Key("times").Value(json::Node(std::move(rows)));
+			}
+			catch (const std::out_of_range&) {
+				builder.Key("error_message").Value("not found");
+			}
+			builder.EndDict();
+		}
+
+		void RequestHandler::ApplySingleIsochroneRequest(json::Builder& builder, const json::Dict& request_data) {
+			if (router_ == nullptr) {
+				throw std::logic_error("");
+			}
+			builder.StartDict().Key("request_id").Value(request_data.at("id").AsInt());
+
+			try {
+				const Stop* from = db_.GetStopByName(request_data.at("from").AsString());
+				const auto reachable = router_->GetReachableStops(from,
+					transport_graph::ToTransportTime(request_data.at("max_time").AsDouble()));
+
+				builder.Key("stops").StartArray();
+				for (const auto& [stop, time] : reachable) {
+					builder.StartDict();
+					builder.Key("stop_name").Value(stop->name_);
+					builder.Key("time").Value(transport_graph::ToMinutes(time));
+					builder.EndDict();
+				}
+				builder.EndArray();
+			}
+			catch (const std::out_of_range&) {
+				builder.Key("error_message").Value("not found");
+			}
+			builder.EndDict();
+		}
+
 		void RequestHandler::Render() {
 			MapRenderSettings settings = GetRenderSettings(reader_.GetRenderSettings());
-			std::vector<Bus*> buses;
-			for (auto it : db_.GetBuses()) {
-				buses.push_back(it.second);
-			}
-			MapRenderer renderer(std::move(settings), buses);
+			MapRenderer renderer(std::move(settings), db_);
 			std::ostringstream oss;
 			renderer.Render(oss);
 
@@ -31,8 +31,16 @@ namespace transport_catalogue {
 
             void ExecuteStatRequest(std::ostream& out);
 
-            void Router();
+            // With the default type the router is planned for the stat request batch: when it routes from
+            // few distinct origins, shortest path trees from those (RouterType::SOURCE_TREES) replace the
+            // all-pairs tables. SOURCE_TREES itself always takes the batch's origins.
+            void Router(transport_graph::RouterType type = transport_graph::RouterType::ALL_PAIRS);
             void Render();
+
+            // Edits after Router(): the graph and the router are patched for the buses the edit touches
+            // instead of being rebuilt. Distances of the roads a new bus takes must already be in the catalogue.
+            void SetDistance(std::string_view stopname1, std::string_view stopname2, double distance);
+            void AddBus(const std::string& busname, const std::vector<std::string>& stopnames, bool is_roundtrip);
             
             std::optional<std::string> GetMap() const;
                 
@@ -48,12 +56,22 @@ namespace transport_catalogue {
             void ApplySingleStopRequest(json::Builder& builder, const json::Dict& request_data);
             void ApplySingleMapRequest(json::Builder& builder, const json::Dict& request_data);
             void ApplySingleRouteRequest(json::Builder& builder, const json::Dict& request_data);
+            void ApplySingleMatrixRequest(json::Builder& builder, const json::Dict& request_data);
+            void ApplySingleIsochroneRequest(json::Builder& builder, const json::Dict& request_data);
+
+            // Distinct origins of the Route and Matrix requests of the batch, as vertices of `graph`
+            std::vector<graph::VertexId> GetBatchRouteOrigins(const transport_graph::TransportGraph& graph) const;
+
+            void UpdateRouter(const std::vector<domain::Bus*>& changed_buses);
            
+            // Trees are planned while the graph has more vertices than this per distinct origin
+            static constexpr size_t PLANNED_VERTICES_PER_ORIGIN = 4;
+
             TransportCatalogue& db_;
             const json_reader::JSONReader reader_;
             std::optional<std::string> rendered_map_;
 
-            std::unique_ptr<transport_graph::TransportGraph> graph_;
+            std::shared_ptr<const transport_graph::TransportGraph> graph_;
             std::unique_ptr<transport_graph::TransportRouter> router_;
         };
     } // ------------------ namespace requests ----------------
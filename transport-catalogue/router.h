@@ -1,11 +1,17 @@
 #pragma once
 
 #include "graph.h"
+#include "huge_page_allocator.h"
+#include "min_plus_kernel.h"
+#include "parallel.h"
+#include "search_workspace.h"
 
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <iterator>
+#include <limits>
+#include <memory>
 #include <optional>
 #include <stdexcept>
 #include <unordered_map>
@@ -14,104 +20,547 @@
 
 namespace graph {
 
+    namespace detail {
+
+        // Every engine reads the graph through its frozen CSR form and relies on non-negative weights
+        template <typename Weight>
+        void CheckRoutableGraph(const DirectedWeightedGraph<Weight>& graph) {
+            if (!graph.IsFrozen()) {
+                throw std::logic_error("Graph should be frozen before routing");
+            }
+            const size_t edge_count = graph.GetEdgeCount();
+            for (EdgeId edge_id = 0; edge_id < edge_count; ++edge_id) {
+                if (graph.GetEdge(edge_id).weight < Weight{}) {
+                    throw std::domain_error("Edges' weights should be non-negative");
+                }
+            }
+        }
+
+    }  // namespace detail
+
+    // Common interface of the routing engines, so that callers can pick one at runtime
     template <typename Weight>
-    class Router {
+    class RouterBase {
+    public:
+        struct RouteInfo {
+            Weight weight;
+            std::vector<EdgeId> edges;
+        };
+
+        virtual ~RouterBase() = default;
+
+        virtual std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const = 0;
+
+        // Weights of the best routes from `from` to each of `targets` (nullopt if unreachable),
+        // without building the routes. Engines override it when they can do better than
+        // one query per target.
+        virtual std::vector<std::optional<Weight>> GetRouteWeights(VertexId from,
+            const std::vector<VertexId>& targets) const {
+            std::vector<std::optional<Weight>> weights;
+            weights.reserve(targets.size());
+            for (const VertexId to : targets) {
+                const std::optional<RouteInfo> route = BuildRoute(from, to);
+                weights.push_back(route ? std::optional<Weight>(route->weight) : std::nullopt);
+            }
+            return weights;
+        }
+    };
+
+    // All-pairs engine: Floyd-Warshall precompute in the constructor, O(1) lookups per query.
+    // The V x V table is stored flat as two arrays, cell weights in `CellWeight` (which may be
+    // narrower than `Weight`, e.g. float) and predecessor edges as 32-bit ids with sentinels
+    // for "unreachable" and "no edge" instead of std::optional.
+    template <typename Weight, typename CellWeight = Weight>
+    class Router : public RouterBase<Weight> {
     private:
         using Graph = DirectedWeightedGraph<Weight>;
 
     public:
+        using RouteInfo = typename RouterBase<Weight>::RouteInfo;
+        using CellEdgeId = uint32_t;
+
         explicit Router(const Graph& graph);
 
-        struct RouteInfo {
-            Weight weight;
-            std::vector<EdgeId> edges;
-        };
+        // Tiled Floyd-Warshall on `thread_count` workers (0 means one per hardware thread).
+        // Builds exactly the same tables as the sequential constructor, bit for bit.
+        Router(const Graph& graph, size_t thread_count, size_t block_size = DEFAULT_BLOCK_SIZE,
+            bool use_huge_pages = false);
+
+        // Serves queries from tables computed earlier for the same graph, e.g. memory-mapped
+        // from a file. Both tables hold V x V cells; `storage` keeps them alive. Throws
+        // std::invalid_argument if a route in `prev_edges` doesn't lead back through edges of `graph`.
+        Router(const Graph& graph, const CellWeight* weights, const CellEdgeId* prev_edges,
+            std::shared_ptr<const void> storage);
 
-        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+        // Repairs the tables of `previous` for `graph` instead of recomputing them. `graph` must be the
+        // graph of `previous` with the weights of `changed_edges` changed and maybe edges appended;
+        // endpoints of existing edges stay the same. Decreased and appended edges are applied one at a
+        // time in O(V^2) each, then the rows whose shortest path tree used an increased edge are
+        // rebuilt by Dijkstra. Rows are spread over `thread_count` workers (0 means one per hardware thread).
+        Router(const Graph& graph, const Router& previous, const std::vector<EdgeId>& changed_edges,
+            size_t thread_count = 1);
+
+        Router(const Router&) = delete;
+        Router& operator=(const Router&) = delete;
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+        // Table lookups only
+        std::vector<std::optional<Weight>> GetRouteWeights(VertexId from,
+            const std::vector<VertexId>& targets) const override;
+
+        // Bytes held by the routing table (tables served from external storage are not counted)
+        size_t GetMemoryUsage() const {
+            return weights_.capacity() * sizeof(CellWeight) + prev_edges_.capacity() * sizeof(CellEdgeId);
+        }
+
+        // Row-major V x V tables, e.g. for saving them
+        const CellWeight* GetWeights() const {
+            return weights_view_;
+        }
+
+        const CellEdgeId* GetPrevEdges() const {
+            return prev_edges_view_;
+        }
 
     private:
-        struct RouteInternalData {
-            Weight weight;
-            std::optional<EdgeId> prev_edge;
-        };
-        using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+        template <typename T>
+        using Table = std::vector<T, HugePageAllocator<T>>;
+
+        static constexpr CellWeight UNREACHABLE = std::numeric_limits<CellWeight>::has_infinity
+            ? std::numeric_limits<CellWeight>::infinity() : std::numeric_limits<CellWeight>::max();
+        static constexpr CellEdgeId NO_EDGE = std::numeric_limits<CellEdgeId>::max();
+
+        size_t GetCellIndex(VertexId vertex_from, VertexId vertex_to) const {
+            return vertex_from * vertex_count_ + vertex_to;
+        }
+
+        // BuildRoute follows prev edges without checks, so tables from outside are checked once:
+        // every reached cell must hold an edge into its vertex, and those edges must lead back
+        // to the row's vertex without a cycle
+        void CheckPrevEdges() const {
+            const size_t edge_count = graph_.GetEdgeCount();
+            // 2 * row + 1 while a vertex is on the chain being walked, 2 * row + 2 once it's known to lead back
+            std::vector<size_t> states(vertex_count_, 0);
+            std::vector<VertexId> chain;
+            for (VertexId vertex_from = 0; vertex_from < vertex_count_; ++vertex_from) {
+                const CellWeight* weights = weights_view_ + GetCellIndex(vertex_from, 0);
+                const CellEdgeId* prev_edges = prev_edges_view_ + GetCellIndex(vertex_from, 0);
+                const size_t on_chain = 2 * static_cast<size_t>(vertex_from) + 1;
+                const size_t checked = on_chain + 1;
+                if (prev_edges[vertex_from] != NO_EDGE || weights[vertex_from] == UNREACHABLE) {
+                    throw std::invalid_argument("Routing tables don't match the graph");
+                }
+                states[vertex_from] = checked;
+                for (VertexId vertex_to = 0; vertex_to < vertex_count_; ++vertex_to) {
+                    if (weights[vertex_to] == UNREACHABLE) {
+                        if (prev_edges[vertex_to] != NO_EDGE) {
+                            throw std::invalid_argument("Routing tables don't match the graph");
+                        }
+                        continue;
+                    }
+                    for (VertexId vertex = vertex_to; states[vertex] != checked;) {
+                        const CellEdgeId edge_id = prev_edges[vertex];
+                        if (states[vertex] == on_chain || edge_id >= edge_count || graph_.GetEdge(edge_id).to != vertex) {
+                            throw std::invalid_argument("Routing tables don't match the graph");
+                        }
+                        states[vertex] = on_chain;
+                        chain.push_back(vertex);
+                        vertex = graph_.GetEdge(edge_id).from;
+                    }
+                    for (const VertexId vertex : chain) {
+                        states[vertex] = checked;
+                    }
+                    chain.clear();
+                }
+            }
+        }
 
         void InitializeRoutesInternalData(const Graph& graph) {
-            const size_t vertex_count = graph.GetVertexCount();
-            for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-                routes_internal_data_[vertex][vertex] = RouteInternalData{ ZERO_WEIGHT, std::nullopt };
-                for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
-                    const auto& edge = graph.GetEdge(edge_id);
-                    if (edge.weight < ZERO_WEIGHT) {
-                        throw std::domain_error("Edges' weights should be non-negative");
+            detail::CheckRoutableGraph(graph);
+            if (graph.GetEdgeCount() >= NO_EDGE) {
+                throw std::length_error("Too many edges for the routing table");
+            }
+            for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+                weights_[GetCellIndex(vertex, vertex)] = static_cast<CellWeight>(ZERO_WEIGHT);
+                const AdjacencySpan<Weight> adjacency = graph.GetAdjacency(vertex);
+                for (size_t i = 0; i < adjacency.size; ++i) {
+                    const size_t cell = GetCellIndex(vertex, adjacency.targets[i]);
+                    const CellWeight edge_weight = static_cast<CellWeight>(adjacency.weights[i]);
+                    if (weights_[cell] > edge_weight) {
+                        weights_[cell] = edge_weight;
+                        prev_edges_[cell] = static_cast<CellEdgeId>(adjacency.edge_ids[i]);
+                    }
+                }
+            }
+        }
+
+        // Pivot row `vertex_through` is not changed while relaxing through it (its own cell
+        // d[through][through] is zero), so `row_to` may alias the table
+        void RelaxRow(VertexId vertex_from, CellWeight weight_from, CellEdgeId prev_edge_from,
+            const CellWeight* row_to_weights, const CellEdgeId* row_to_prev_edges,
+            VertexId column_begin, VertexId column_end) {
+            relax_row_kernel_(weights_.data() + GetCellIndex(vertex_from, 0), prev_edges_.data() + GetCellIndex(vertex_from, 0),
+                weight_from, prev_edge_from, row_to_weights, row_to_prev_edges, NO_EDGE, column_begin, column_end);
+        }
+
+        void RelaxRoutesInternalDataThroughVertex(VertexId vertex_through) {
+            const CellWeight* row_through_weights = weights_.data() + GetCellIndex(vertex_through, 0);
+            const CellEdgeId* row_through_prev_edges = prev_edges_.data() + GetCellIndex(vertex_through, 0);
+            for (VertexId vertex_from = 0; vertex_from < vertex_count_; ++vertex_from) {
+                const size_t cell_from = GetCellIndex(vertex_from, vertex_through);
+                if (weights_[cell_from] != UNREACHABLE) {
+                    RelaxRow(vertex_from, weights_[cell_from], prev_edges_[cell_from],
+                        row_through_weights, row_through_prev_edges, 0, vertex_count_);
+                }
+            }
+        }
+
+        // Operands of one block of pivots as the sequential algorithm sees them: column snapshot k
+        // holds d[i][k] and row snapshot k holds d[k][j], both taken when pivot k is processed.
+        // Later pivots of the block may still improve these cells, so tiles relax through the
+        // snapshots instead of the live table.
+        struct PivotSnapshots {
+            VertexId first_pivot = 0;
+            size_t vertex_count = 0;
+            std::vector<CellWeight> column_weights;
+            std::vector<CellEdgeId> column_prev_edges;
+            std::vector<CellWeight> row_weights;
+            std::vector<CellEdgeId> row_prev_edges;
+
+            size_t GetIndex(VertexId pivot, VertexId vertex) const {
+                return (pivot - first_pivot) * vertex_count + vertex;
+            }
+        };
+
+        struct Tile {
+            VertexId row_begin;
+            VertexId row_end;
+            VertexId column_begin;
+            VertexId column_end;
+        };
+
+        // Relaxes the tile through pivots [pivot_begin, pivot_end) in ascending order. A tile crossing
+        // the pivot rows/columns records their values into the snapshots first.
+        void RelaxTile(const Tile& tile, VertexId pivot_begin, VertexId pivot_end, PivotSnapshots& snapshots) {
+            for (VertexId pivot = pivot_begin; pivot < pivot_end; ++pivot) {
+                if (tile.column_begin <= pivot && pivot < tile.column_end) {
+                    for (VertexId vertex_from = tile.row_begin; vertex_from < tile.row_end; ++vertex_from) {
+                        const size_t cell = GetCellIndex(vertex_from, pivot);
+                        snapshots.column_weights[snapshots.GetIndex(pivot, vertex_from)] = weights_[cell];
+                        snapshots.column_prev_edges[snapshots.GetIndex(pivot, vertex_from)] = prev_edges_[cell];
                     }
-                    auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                    if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                        route_internal_data = RouteInternalData{ edge.weight, edge_id };
+                }
+                if (tile.row_begin <= pivot && pivot < tile.row_end) {
+                    std::copy(weights_.begin() + GetCellIndex(pivot, tile.column_begin),
+                        weights_.begin() + GetCellIndex(pivot, tile.column_end),
+                        snapshots.row_weights.begin() + snapshots.GetIndex(pivot, tile.column_begin));
+                    std::copy(prev_edges_.begin() + GetCellIndex(pivot, tile.column_begin),
+                        prev_edges_.begin() + GetCellIndex(pivot, tile.column_end),
+                        snapshots.row_prev_edges.begin() + snapshots.GetIndex(pivot, tile.column_begin));
+                }
+
+                const CellWeight* row_weights = snapshots.row_weights.data() + snapshots.GetIndex(pivot, 0);
+                const CellEdgeId* row_prev_edges = snapshots.row_prev_edges.data() + snapshots.GetIndex(pivot, 0);
+                for (VertexId vertex_from = tile.row_begin; vertex_from < tile.row_end; ++vertex_from) {
+                    const size_t snapshot_from = snapshots.GetIndex(pivot, vertex_from);
+                    if (snapshots.column_weights[snapshot_from] != UNREACHABLE) {
+                        RelaxRow(vertex_from, snapshots.column_weights[snapshot_from], snapshots.column_prev_edges[snapshot_from],
+                            row_weights, row_prev_edges, tile.column_begin, tile.column_end);
                     }
                 }
             }
         }
 
-        void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-            const RouteInternalData& route_to) {
-            auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-            const Weight candidate_weight = route_from.weight + route_to.weight;
-            if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-                route_relaxing = { candidate_weight,
-                                  route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge };
+        // Each round takes one block of pivots: the diagonal tile first, then the tiles sharing
+        // its rows or columns in parallel, then all the remaining tiles in parallel
+        void RelaxRoutesInternalDataBlocked(size_t thread_count, size_t block_size) {
+            const size_t vertex_count = vertex_count_;
+            const size_t block_count = (vertex_count + block_size - 1) / block_size;
+            const auto block_begin = [block_size](size_t block) {
+                return block * block_size;
+            };
+            const auto block_end = [block_size, vertex_count](size_t block) {
+                return std::min(vertex_count, (block + 1) * block_size);
+            };
+
+            PivotSnapshots snapshots;
+            snapshots.vertex_count = vertex_count;
+            snapshots.column_weights.resize(block_size * vertex_count);
+            snapshots.column_prev_edges.resize(block_size * vertex_count);
+            snapshots.row_weights.resize(block_size * vertex_count);
+            snapshots.row_prev_edges.resize(block_size * vertex_count);
+
+            for (size_t pivot_block = 0; pivot_block < block_count; ++pivot_block) {
+                const VertexId pivot_begin = block_begin(pivot_block);
+                const VertexId pivot_end = block_end(pivot_block);
+                snapshots.first_pivot = pivot_begin;
+
+                RelaxTile({ pivot_begin, pivot_end, pivot_begin, pivot_end }, pivot_begin, pivot_end, snapshots);
+
+                parallel::ForEachIndex(2 * block_count, thread_count, [&](size_t task) {
+                    const size_t block = task / 2;
+                    if (block == pivot_block) {
+                        return;
+                    }
+                    if (task % 2 == 0) {
+                        RelaxTile({ pivot_begin, pivot_end, block_begin(block), block_end(block) }, pivot_begin, pivot_end, snapshots);
+                    }
+                    else {
+                        RelaxTile({ block_begin(block), block_end(block), pivot_begin, pivot_end }, pivot_begin, pivot_end, snapshots);
+                    }
+                });
+
+                parallel::ForEachIndex(block_count * block_count, thread_count, [&](size_t task) {
+                    const size_t row_block = task / block_count;
+                    const size_t column_block = task % block_count;
+                    if (row_block == pivot_block || column_block == pivot_block) {
+                        return;
+                    }
+                    RelaxTile({ block_begin(row_block), block_end(row_block), block_begin(column_block), block_end(column_block) },
+                        pivot_begin, pivot_end, snapshots);
+                });
             }
         }
 
-        void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-            for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-                if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-                    for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                        if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                            RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
-                        }
+        // d[i][j] = min(d[i][j], d[i][from] + w + d[to][j]) for every cell. Row `to` can't improve
+        // through the edge (d[to][from] + w >= 0), so rows are independent. A row whose distance to
+        // `to` doesn't improve keeps every cell, so most rows are skipped after one comparison.
+        void ApplyDecreasedEdge(EdgeId edge_id, size_t thread_count) {
+            const Edge<Weight>& edge = graph_.GetEdge(edge_id);
+            const CellWeight edge_weight = static_cast<CellWeight>(edge.weight);
+            if (!(edge_weight < weights_[GetCellIndex(edge.from, edge.to)])) {
+                return;
+            }
+            const CellWeight* row_to_weights = weights_.data() + GetCellIndex(edge.to, 0);
+            const CellEdgeId* row_to_prev_edges = prev_edges_.data() + GetCellIndex(edge.to, 0);
+            parallel::ForEachIndex(vertex_count_, thread_count, [&](size_t vertex_from) {
+                const CellWeight weight_from = weights_[GetCellIndex(vertex_from, edge.from)];
+                if (weight_from == UNREACHABLE || vertex_from == edge.to) {
+                    return;
+                }
+                const CellWeight weight_through = weight_from + edge_weight;
+                if (weight_through < weights_[GetCellIndex(vertex_from, edge.to)]) {
+                    RelaxRowThroughEdge(vertex_from, weight_through, static_cast<CellEdgeId>(edge_id),
+                        row_to_weights, row_to_prev_edges);
+                }
+            });
+        }
+
+        void RelaxRowThroughEdge(VertexId vertex_from, CellWeight weight_through, CellEdgeId edge_id,
+            const CellWeight* row_to_weights, const CellEdgeId* row_to_prev_edges) {
+            CellWeight* weights = weights_.data() + GetCellIndex(vertex_from, 0);
+            CellEdgeId* prev_edges = prev_edges_.data() + GetCellIndex(vertex_from, 0);
+            for (VertexId vertex_to = 0; vertex_to < vertex_count_; ++vertex_to) {
+                if (row_to_weights[vertex_to] == UNREACHABLE) {
+                    continue;
+                }
+                const CellWeight candidate_weight = weight_through + row_to_weights[vertex_to];
+                if (candidate_weight < weights[vertex_to]) {
+                    weights[vertex_to] = candidate_weight;
+                    prev_edges[vertex_to] = row_to_prev_edges[vertex_to] != NO_EDGE
+                        ? row_to_prev_edges[vertex_to] : edge_id;
+                }
+            }
+        }
+
+        // Full Dijkstra from `vertex_from` over the current graph, written over its row
+        void RebuildRow(VertexId vertex_from, detail::SearchState<Weight>& state) {
+            state.Start();
+            state.Reach(vertex_from, ZERO_WEIGHT, std::nullopt);
+            state.Push(ZERO_WEIGHT, vertex_from);
+            while (!state.IsQueueEmpty()) {
+                const auto [weight, vertex] = state.Pop();
+                if (weight > state.weights[vertex]) {
+                    continue;
+                }
+                const AdjacencySpan<Weight> adjacency = graph_.GetAdjacency(vertex);
+                for (size_t i = 0; i < adjacency.size; ++i) {
+                    const VertexId target = adjacency.targets[i];
+                    const Weight candidate_weight = weight + adjacency.weights[i];
+                    if (!state.IsReached(target) || candidate_weight < state.weights[target]) {
+                        state.Reach(target, candidate_weight, adjacency.edge_ids[i]);
+                        state.Push(candidate_weight, target);
                     }
                 }
             }
+
+            CellWeight* weights = weights_.data() + GetCellIndex(vertex_from, 0);
+            CellEdgeId* prev_edges = prev_edges_.data() + GetCellIndex(vertex_from, 0);
+            for (VertexId vertex_to = 0; vertex_to < vertex_count_; ++vertex_to) {
+                const bool is_reached = state.IsReached(vertex_to);
+                weights[vertex_to] = is_reached ? static_cast<CellWeight>(state.weights[vertex_to]) : UNREACHABLE;
+                prev_edges[vertex_to] = is_reached && state.prev_edges[vertex_to]
+                    ? static_cast<CellEdgeId>(*state.prev_edges[vertex_to]) : NO_EDGE;
+            }
         }
 
+        static constexpr size_t DEFAULT_BLOCK_SIZE = 64;
         static constexpr Weight ZERO_WEIGHT{};
         const Graph& graph_;
-        RoutesInternalData routes_internal_data_;
+        size_t vertex_count_ = 0;
+        Table<CellWeight> weights_;
+        Table<CellEdgeId> prev_edges_;
+        std::shared_ptr<const void> external_storage_;
+        const CellWeight* weights_view_ = nullptr;
+        const CellEdgeId* prev_edges_view_ = nullptr;
+        // Picked for the running CPU, see min_plus_kernel.h
+        const detail::RelaxRowKernel<CellWeight, CellEdgeId> relax_row_kernel_ = detail::SelectRelaxRowKernel<CellWeight, CellEdgeId>();
     };
 
-    template <typename Weight>
-    Router<Weight>::Router(const Graph& graph)
+    template <typename Weight, typename CellWeight>
+    Router<Weight, CellWeight>::Router(const Graph& graph)
         : graph_(graph)
-        , routes_internal_data_(graph.GetVertexCount(),
-            std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
+        , vertex_count_(graph.GetVertexCount())
+        , weights_(vertex_count_ * vertex_count_, UNREACHABLE)
+        , prev_edges_(vertex_count_ * vertex_count_, NO_EDGE)
     {
         InitializeRoutesInternalData(graph);
 
-        const size_t vertex_count = graph.GetVertexCount();
-        for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-            RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+        for (VertexId vertex_through = 0; vertex_through < vertex_count_; ++vertex_through) {
+            RelaxRoutesInternalDataThroughVertex(vertex_through);
         }
+        weights_view_ = weights_.data();
+        prev_edges_view_ = prev_edges_.data();
     }
 
-    template <typename Weight>
-    std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
+    template <typename Weight, typename CellWeight>
+    Router<Weight, CellWeight>::Router(const Graph& graph, size_t thread_count, size_t block_size, bool use_huge_pages)
+        : graph_(graph)
+        , vertex_count_(graph.GetVertexCount())
+        , weights_(vertex_count_ * vertex_count_, UNREACHABLE, HugePageAllocator<CellWeight>(use_huge_pages))
+        , prev_edges_(vertex_count_ * vertex_count_, NO_EDGE, HugePageAllocator<CellEdgeId>(use_huge_pages))
+    {
+        if (block_size == 0) {
+            throw std::invalid_argument("Block size should be positive");
+        }
+        InitializeRoutesInternalData(graph);
+        RelaxRoutesInternalDataBlocked(thread_count, block_size);
+        weights_view_ = weights_.data();
+        prev_edges_view_ = prev_edges_.data();
+    }
+
+    template <typename Weight, typename CellWeight>
+    Router<Weight, CellWeight>::Router(const Graph& graph, const CellWeight* weights, const CellEdgeId* prev_edges,
+        std::shared_ptr<const void> storage)
+        : graph_(graph)
+        , vertex_count_(graph.GetVertexCount())
+        , external_storage_(std::move(storage))
+        , weights_view_(weights)
+        , prev_edges_view_(prev_edges)
+    {
+        CheckPrevEdges();
+    }
+
+    template <typename Weight, typename CellWeight>
+    Router<Weight, CellWeight>::Router(const Graph& graph, const Router& previous, const std::vector<EdgeId>& changed_edges,
+        size_t thread_count)
+        : graph_(graph)
+        , vertex_count_(graph.GetVertexCount())
+        , weights_(previous.weights_.get_allocator())
+        , prev_edges_(previous.prev_edges_.get_allocator())
+    {
+        detail::CheckRoutableGraph(graph);
+        const Graph& previous_graph = previous.graph_;
+        const size_t previous_edge_count = previous_graph.GetEdgeCount();
+        if (vertex_count_ != previous.vertex_count_ || graph.GetEdgeCount() < previous_edge_count) {
+            throw std::invalid_argument("Graph should only differ in edges' weights and appended edges");
+        }
+        if (graph.GetEdgeCount() >= NO_EDGE) {
+            throw std::length_error("Too many edges for the routing table");
+        }
+
+        const size_t cell_count = vertex_count_ * vertex_count_;
+        weights_.assign(previous.weights_view_, previous.weights_view_ + cell_count);
+        prev_edges_.assign(previous.prev_edges_view_, previous.prev_edges_view_ + cell_count);
+        weights_view_ = weights_.data();
+        prev_edges_view_ = prev_edges_.data();
+
+        std::vector<EdgeId> decreased_edges;
+        std::vector<EdgeId> increased_edges;
+        for (const EdgeId edge_id : changed_edges) {
+            if (edge_id >= previous_edge_count) {
+                continue;
+            }
+            const Edge<Weight>& edge = graph.GetEdge(edge_id);
+            const Edge<Weight>& previous_edge = previous_graph.GetEdge(edge_id);
+            if (edge.from != previous_edge.from || edge.to != previous_edge.to) {
+                throw std::invalid_argument("Graph should only differ in edges' weights and appended edges");
+            }
+            if (edge.weight < previous_edge.weight) {
+                decreased_edges.push_back(edge_id);
+            }
+            else if (previous_edge.weight < edge.weight) {
+                increased_edges.push_back(edge_id);
+            }
+        }
+        for (EdgeId edge_id = previous_edge_count; edge_id < graph.GetEdgeCount(); ++edge_id) {
+            decreased_edges.push_back(edge_id);
+        }
+
+        // Increased edges still count with their old weights here, so the tables stay exact
+        // for that intermediate graph after every step
+        for (const EdgeId edge_id : decreased_edges) {
+            ApplyDecreasedEdge(edge_id, thread_count);
+        }
+
+        // A row keeps its distances unless its shortest path tree enters some vertex by an increased edge
+        std::vector<VertexId> rows_to_rebuild;
+        for (VertexId vertex_from = 0; vertex_from < vertex_count_; ++vertex_from) {
+            const bool uses_increased_edge = std::any_of(increased_edges.begin(), increased_edges.end(),
+                [&](EdgeId edge_id) {
+                    return prev_edges_[GetCellIndex(vertex_from, graph.GetEdge(edge_id).to)] == edge_id;
+                });
+            if (uses_increased_edge) {
+                rows_to_rebuild.push_back(vertex_from);
+            }
+        }
+        detail::WorkspacePool<detail::SearchState<Weight>> workspaces;
+        parallel::ForEachIndex(rows_to_rebuild.size(), thread_count, [&](size_t i) {
+            const auto holder = workspaces.Acquire(vertex_count_);
+            RebuildRow(rows_to_rebuild[i], *holder);
+        });
+    }
+
+    template <typename Weight, typename CellWeight>
+    std::optional<typename Router<Weight, CellWeight>::RouteInfo> Router<Weight, CellWeight>::BuildRoute(VertexId from,
         VertexId to) const {
-        const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-        if (!route_internal_data) {
+        if (from >= vertex_count_ || to >= vertex_count_) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        const size_t cell = GetCellIndex(from, to);
+        if (weights_view_[cell] == UNREACHABLE) {
             return std::nullopt;
         }
-        const Weight weight = route_internal_data->weight;
+        const Weight weight = static_cast<Weight>(weights_view_[cell]);
         std::vector<EdgeId> edges;
-        for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-            edge_id;
-            edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+        for (CellEdgeId edge_id = prev_edges_view_[cell];
+            edge_id != NO_EDGE;
+            edge_id = prev_edges_view_[GetCellIndex(from, graph_.GetEdge(edge_id).from)])
         {
-            edges.push_back(*edge_id);
+            edges.push_back(edge_id);
         }
         std::reverse(edges.begin(), edges.end());
 
         return RouteInfo{ weight, std::move(edges) };
     }
 
+    template <typename Weight, typename CellWeight>
+    std::vector<std::optional<Weight>> Router<Weight, CellWeight>::GetRouteWeights(VertexId from,
+        const std::vector<VertexId>& targets) const {
+        if (from >= vertex_count_) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        std::vector<std::optional<Weight>> weights;
+        weights.reserve(targets.size());
+        for (const VertexId to : targets) {
+            if (to >= vertex_count_) {
+                throw std::out_of_range("Vertex id is out of range");
+            }
+            const CellWeight weight = weights_view_[GetCellIndex(from, to)];
+            weights.push_back(weight == UNREACHABLE ? std::nullopt : std::optional<Weight>(static_cast<Weight>(weight)));
+        }
+        return weights;
+    }
+
 }  // namespace graph
\ No newline at end of file
@@ -0,0 +1,439 @@
+#include "router_serialization.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TRANSPORT_CATALOGUE_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std::literals;
+
+namespace transport_graph {
+	namespace serialization {
+
+		namespace {
+
+			// File layout (native byte order, the file is a cache for the same machine):
+			// FileHeader, stops (name, vertex ids), bus names, edges with their metadata,
+			// zero padding up to `tables_offset` (page aligned), V x V weights, V x V prev edge ids.
+			constexpr char FILE_MAGIC[8] = { 'T', 'C', 'R', 'O', 'U', 'T', 'E', 'S' };
+			constexpr uint32_t FORMAT_VERSION = 2;
+			constexpr uint64_t TABLES_ALIGNMENT = 4096;
+			constexpr uint32_t NO_INDEX = std::numeric_limits<uint32_t>::max();
+
+			struct FileHeader {
+				char magic[8];
+				uint32_t version;
+				uint32_t weight_size;
+				uint32_t model;
+				uint32_t reserved;
+				uint64_t key;
+				uint64_t stop_count;
+				uint64_t bus_count;
+				uint64_t vertex_count;
+				uint64_t edge_count;
+				uint64_t tables_offset;
+			};
+
+			// ---------------- hashing ----------------
+
+			class Fnv1aHasher {
+			public:
+				void Add(const void* data, size_t size) {
+					const auto* bytes = static_cast<const unsigned char*>(data);
+					for (size_t i = 0; i < size; ++i) {
+						hash_ = (hash_ ^ bytes[i]) * PRIME;
+					}
+				}
+
+				template <typename T>
+				void AddValue(const T& value) {
+					Add(&value, sizeof(value));
+				}
+
+				void AddString(std::string_view str) {
+					AddValue(static_cast<uint64_t>(str.size()));
+					Add(str.data(), str.size());
+				}
+
+				uint64_t Get() const {
+					return hash_;
+				}
+
+			private:
+				static constexpr uint64_t PRIME = 1099511628211ull;
+				uint64_t hash_ = 14695981039346656037ull;
+			};
+
+			// Hashes the exact parsed values (doubles bit for bit), tagged by type
+			void HashNode(Fnv1aHasher& hasher, const json::Node& node) {
+				const json::Node::Value& value = node.GetValue();
+				hasher.AddValue(static_cast<uint8_t>(value.index()));
+				if (node.IsArray()) {
+					hasher.AddValue(static_cast<uint64_t>(node.AsArray().size()));
+					for (const json::Node& item : node.AsArray()) {
+						HashNode(hasher, item);
+					}
+				}
+				else if (node.IsDict()) {
+					hasher.AddValue(static_cast<uint64_t>(node.AsDict().size()));
+					for (const auto& [key, item] : node.AsDict()) {
+						hasher.AddString(key);
+						HashNode(hasher, item);
+					}
+				}
+				else if (node.IsBool()) {
+					hasher.AddValue(node.AsBool());
+				}
+				else if (node.IsInt()) {
+					hasher.AddValue(node.AsInt());
+				}
+				else if (node.IsPureDouble()) {
+					hasher.AddValue(node.AsDouble());
+				}
+				else if (node.IsString()) {
+					hasher.AddString(node.AsString());
+				}
+			}
+
+			// ---------------- writing ----------------
+
+			template <typename T>
+			void WriteValue(std::ostream& out, const T& value) {
+				out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+			}
+
+			void WriteString(std::ostream& out, std::string_view str) {
+				WriteValue(out, static_cast<uint32_t>(str.size()));
+				out.write(str.data(), str.size());
+			}
+
+			template <typename T>
+			void WriteTable(std::ostream& out, const T* table, size_t size) {
+				if (size > 0) {
+					out.write(reinterpret_cast<const char*>(table), size * sizeof(T));
+				}
+			}
+
+			// ---------------- reading ----------------
+
+			// Whole file in memory: mapped read-only where possible, read into a buffer otherwise
+			class MappedFile {
+			public:
+				static std::shared_ptr<const MappedFile> Open(const std::string& path) {
+					auto file = std::shared_ptr<MappedFile>(new MappedFile());
+#ifdef TRANSPORT_CATALOGUE_HAS_MMAP
+					const int fd = open(path.c_str(), O_RDONLY);
+					if (fd < 0) {
+						return nullptr;
+					}
+					struct stat file_stat {};
+					if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+						close(fd);
+						return nullptr;
+					}
+					void* data = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+					close(fd);
+					if (data == MAP_FAILED) {
+						return nullptr;
+					}
+					file->data_ = data;
+					file->size_ = static_cast<size_t>(file_stat.st_size);
+#else
+					std::ifstream in(path, std::ios::binary | std::ios::ate);
+					if (!in) {
+						return nullptr;
+					}
+					file->buffer_.resize(static_cast<size_t>(in.tellg()));
+					in.seekg(0);
+					if (!in.read(file->buffer_.data(), file->buffer_.size())) {
+						return nullptr;
+					}
+#endif
+					return file;
+				}
+
+				MappedFile(const MappedFile&) = delete;
+				MappedFile& operator=(const MappedFile&) = delete;
+
+				~MappedFile() {
+#ifdef TRANSPORT_CATALOGUE_HAS_MMAP
+					if (data_ != nullptr) {
+						munmap(data_, size_);
+					}
+#endif
+				}
+
+				const char* GetData() const {
+#ifdef TRANSPORT_CATALOGUE_HAS_MMAP
+					return static_cast<const char*>(data_);
+#else
+					return buffer_.data();
+#endif
+				}
+
+				size_t GetSize() const {
+#ifdef TRANSPORT_CATALOGUE_HAS_MMAP
+					return size_;
+#else
+					return buffer_.size();
+#endif
+				}
+
+			private:
+				MappedFile() = default;
+
+#ifdef TRANSPORT_CATALOGUE_HAS_MMAP
+				void* data_ = nullptr;
+				size_t size_ = 0;
+#else
+				std::vector<char> buffer_;
+#endif
+			};
+
+			class Reader {
+			public:
+				Reader(const char* data, size_t size)
+					:data_(data), size_(size) {
+				}
+
+				template <typename T>
+				T ReadValue() {
+					T value;
+					std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+					return value;
+				}
+
+				std::string_view ReadString() {
+					const uint32_t size = ReadValue<uint32_t>();
+					return { Take(size), size };
+				}
+
+				size_t GetOffset() const {
+					return offset_;
+				}
+
+			private:
+				const char* Take(size_t size) {
+					if (size > size_ - offset_) {
+						throw std::out_of_range("Saved routes are truncated");
+					}
+					const char* result = data_ + offset_;
+					offset_ += size;
+					return result;
+				}
+
+				const char* data_;
+				size_t size_;
+				size_t offset_ = 0;
+			};
+
+			void CheckSaved(bool condition) {
+				if (!condition) {
+					throw std::invalid_argument("Saved routes don't match the catalogue");
+				}
+			}
+
+		} // namespace
+
+		uint64_t ComputeRoutesKey(const json::Node& base_requests, const json::Node& routing_settings) {
+			Fnv1aHasher hasher;
+			HashNode(hasher, base_requests);
+			HashNode(hasher, routing_settings);
+			return hasher.Get();
+		}
+
+		bool SaveRoutes(const std::string& path, uint64_t key, const TransportGraph& graph, const AllPairsRouter& router) {
+			const auto& routes_graph = graph.GetGraph();
+			const auto& edge_id_to_graph_data = graph.GetEdgeIdToGraphData();
+			const size_t vertex_count = routes_graph.GetVertexCount();
+			const size_t edge_count = routes_graph.GetEdgeCount();
+
+			// Stops with vertices, in id order
+			const auto& stop_vertex_ids = graph.GetStopVertexIds();
+			std::vector<const domain::Stop*> stops;
+			std::unordered_map<const domain::Stop*, uint32_t> stop_indices;
+			for (domain::StopId stop_id = 0; stop_id < stop_vertex_ids.size(); ++stop_id) {
+				if (stop_vertex_ids[stop_id].id != TransportGraph::NO_VERTEX) {
+					const domain::Stop* stop = graph.GetCatalogue().GetStop(stop_id);
+					stop_indices.emplace(stop, static_cast<uint32_t>(stops.size()));
+					stops.push_back(stop);
+				}
+			}
+
+			std::vector<const domain::Bus*> buses;
+			std::unordered_map<const domain::Bus*, uint32_t> bus_indices;
+			for (graph::EdgeId id = 0; id < edge_count; ++id) {
+				const domain::Bus* bus = edge_id_to_graph_data.at(id).bus;
+				if (bus != nullptr && bus_indices.emplace(bus, static_cast<uint32_t>(buses.size())).second) {
+					buses.push_back(bus);
+				}
+			}
+
+			const std::string temp_path = path + ".tmp"s;
+			{
+				std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+				if (!out) {
+					return false;
+				}
+
+				FileHeader header{};
+				std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+				header.version = FORMAT_VERSION;
+				header.weight_size = sizeof(TransportTime);
+				header.model = static_cast<uint32_t>(graph.GetModel());
+				header.key = key;
+				header.stop_count = stops.size();
+				header.bus_count = buses.size();
+				header.vertex_count = vertex_count;
+				header.edge_count = edge_count;
+				WriteValue(out, header);
+
+				for (const domain::Stop* stop : stops) {
+					const VertexIdLoop& vertex_id = stop_vertex_ids[stop->id_];
+					WriteString(out, stop->name_);
+					WriteValue(out, static_cast<uint64_t>(vertex_id.id));
+					WriteValue(out, static_cast<uint64_t>(vertex_id.transfer_id));
+				}
+				for (const domain::Bus* bus : buses) {
+					WriteString(out, bus->name_);
+				}
+				for (graph::EdgeId id = 0; id < edge_count; ++id) {
+					const graph::Edge<TransportTime>& edge = routes_graph.GetEdge(id);
+					const TransportGraphData& data = edge_id_to_graph_data.at(id);
+					WriteValue(out, static_cast<uint64_t>(edge.from));
+					WriteValue(out, static_cast<uint64_t>(edge.to));
+					WriteValue(out, edge.weight);
+					WriteValue(out, stop_indices.at(data.stop_from));
+					WriteValue(out, stop_indices.at(data.stop_to));
+					WriteValue(out, data.bus == nullptr ? NO_INDEX : bus_indices.at(data.bus));
+					WriteValue(out, static_cast<int32_t>(data.stop_count));
+					WriteValue(out, data.time);
+				}
+
+				const uint64_t metadata_end = static_cast<uint64_t>(out.tellp());
+				header.tables_offset = (metadata_end + TABLES_ALIGNMENT - 1) / TABLES_ALIGNMENT * TABLES_ALIGNMENT;
+				out.write(std::string(header.tables_offset - metadata_end, '\0').data(), header.tables_offset - metadata_end);
+
+				WriteTable(out, router.GetWeights(), vertex_count * vertex_count);
+				WriteTable(out, router.GetPrevEdges(), vertex_count * vertex_count);
+
+				out.seekp(0);
+				WriteValue(out, header);
+				if (!out.flush()) {
+					out.close();
+					std::remove(temp_path.c_str());
+					return false;
+				}
+			}
+
+			if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+				std::remove(temp_path.c_str());
+				return false;
+			}
+			return true;
+		}
+
+		std::optional<SavedRoutes> LoadRoutes(const std::string& path, uint64_t key, const TransportCatalogue& catalogue) {
+			const std::shared_ptr<const MappedFile> file = MappedFile::Open(path);
+			if (file == nullptr) {
+				return std::nullopt;
+			}
+
+			try {
+				Reader reader(file->GetData(), file->GetSize());
+
+				const FileHeader header = reader.ReadValue<FileHeader>();
+				if (std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0
+					|| header.version != FORMAT_VERSION
+					|| header.weight_size != sizeof(TransportTime)
+					|| header.key != key) {
+					return std::nullopt;
+				}
+				const GraphModel model = static_cast<GraphModel>(header.model);
+				if (model == GraphModel::WAIT_VERTICES) {
+					CheckSaved(header.stop_count == catalogue.GetStops().size());
+					CheckSaved(header.vertex_count == header.stop_count * 2);
+				}
+				else {
+					CheckSaved(model == GraphModel::COMPACT);
+					CheckSaved(header.stop_count <= catalogue.GetStops().size());
+					CheckSaved(header.vertex_count == header.stop_count);
+				}
+				CheckSaved(header.edge_count < NO_INDEX);
+
+				const size_t vertex_count = header.vertex_count;
+				std::vector<const domain::Stop*> stops;
+				std::vector<VertexIdLoop> stop_vertex_ids(catalogue.GetStops().size(), VertexIdLoop{ TransportGraph::NO_VERTEX, TransportGraph::NO_VERTEX });
+				for (uint64_t i = 0; i < header.stop_count; ++i) {
+					const domain::Stop* stop = catalogue.GetStopByName(reader.ReadString());
+					const auto id = reader.ReadValue<uint64_t>();
+					const auto transfer_id = reader.ReadValue<uint64_t>();
+					CheckSaved(id < vertex_count && transfer_id < vertex_count);
+					stop_vertex_ids[stop->id_] = VertexIdLoop{ id, transfer_id };
+					stops.push_back(stop);
+				}
+
+				std::vector<const domain::Bus*> buses;
+				for (uint64_t i = 0; i < header.bus_count; ++i) {
+					buses.push_back(catalogue.GetBusByName(reader.ReadString()));
+				}
+
+				graph::DirectedWeightedGraph<TransportTime> routes_graph(vertex_count);
+				std::vector<TransportGraphData> edge_id_to_graph_data;
+				edge_id_to_graph_data.reserve(header.edge_count);
+				for (uint64_t i = 0; i < header.edge_count; ++i) {
+					graph::Edge<TransportTime> edge;
+					edge.from = reader.ReadValue<uint64_t>();
+					edge.to = reader.ReadValue<uint64_t>();
+					edge.weight = reader.ReadValue<TransportTime>();
+					const auto stop_from = reader.ReadValue<uint32_t>();
+					const auto stop_to = reader.ReadValue<uint32_t>();
+					const auto bus = reader.ReadValue<uint32_t>();
+					const auto stop_count = reader.ReadValue<int32_t>();
+					const auto time = reader.ReadValue<TransportTime>();
+					CheckSaved(edge.from < vertex_count && edge.to < vertex_count);
+					CheckSaved(stop_from < stops.size() && stop_to < stops.size());
+					CheckSaved(bus == NO_INDEX || bus < buses.size());
+
+					routes_graph.AddEdge(edge);
+					edge_id_to_graph_data.push_back(TransportGraphData{ stops[stop_from], stops[stop_to],
+						bus == NO_INDEX ? nullptr : buses[bus], stop_count, time });
+				}
+
+				const size_t cell_count = vertex_count * vertex_count;
+				const size_t tables_size = cell_count * (sizeof(TransportTime) + sizeof(AllPairsRouter::CellEdgeId));
+				CheckSaved(header.tables_offset % TABLES_ALIGNMENT == 0 && header.tables_offset >= reader.GetOffset());
+				CheckSaved(header.tables_offset <= file->GetSize() && tables_size <= file->GetSize() - header.tables_offset);
+
+				auto transport_graph = std::make_shared<const TransportGraph>(catalogue, std::move(routes_graph),
+					std::move(edge_id_to_graph_data), std::move(stop_vertex_ids), model);
+				const char* tables = file->GetData() + header.tables_offset;
+				auto router = std::make_unique<AllPairsRouter>(transport_graph->GetGraph(),
+					reinterpret_cast<const TransportTime*>(tables),
+					reinterpret_cast<const AllPairsRouter::CellEdgeId*>(tables + cell_count * sizeof(TransportTime)),
+					file);
+
+				return SavedRoutes{ std::move(transport_graph), std::move(router) };
+			}
+			catch (const std::exception&) {
+				return std::nullopt;
+			}
+		}
+
+	} // ------------------ namespace serialization ----------------
+
+} // ------------------ namespace transport_graph ----------------
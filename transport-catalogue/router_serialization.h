@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "json.h"
+#include "router.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+namespace transport_graph {
+	namespace serialization {
+
+		using AllPairsRouter = graph::Router<TransportTime>;
+
+		// Graph and all-pairs tables restored from a file. The router serves BuildRoute straight
+		// from the memory-mapped tables and references `graph`, so keep both together.
+		struct SavedRoutes {
+			std::shared_ptr<const TransportGraph> graph;
+			std::unique_ptr<AllPairsRouter> router;
+		};
+
+		// Identifies the routing input: saved routes are only reused when the base requests
+		// and routing settings hash to the same key
+		uint64_t ComputeRoutesKey(const json::Node& base_requests, const json::Node& routing_settings);
+
+		// Writes the graph, its edge metadata and the router tables to `path` (through a temporary
+		// file, so readers never see a partial one). Returns false if the file can't be written.
+		bool SaveRoutes(const std::string& path, uint64_t key, const TransportGraph& graph, const AllPairsRouter& router);
+
+		// Maps a file written by SaveRoutes read-only. Returns nullopt when it is missing, was written
+		// by another format version or for another key, or doesn't match the catalogue, or its
+		// route table doesn't hold routes through the saved graph.
+		std::optional<SavedRoutes> LoadRoutes(const std::string& path, uint64_t key, const TransportCatalogue& catalogue);
+
+	} // ------------------ namespace serialization ----------------
+
+} // ------------------ namespace transport_graph ----------------
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace graph {
+    namespace detail {
+
+        // Min-queue of (key, value) items over std::push_heap/pop_heap, ties popped by value.
+        // Works for any key; a vertex whose key drops is pushed again rather than decreased.
+        template <typename Key, typename Value>
+        class BinaryHeap {
+        public:
+            using Item = std::pair<Key, Value>;
+
+            void Clear() {
+                items_.clear();
+            }
+
+            bool IsEmpty() const {
+                return items_.empty();
+            }
+
+            void Push(Key key, Value value) {
+                items_.push_back({ key, value });
+                std::push_heap(items_.begin(), items_.end(), std::greater<Item>{});
+            }
+
+            Item Pop() {
+                std::pop_heap(items_.begin(), items_.end(), std::greater<Item>{});
+                const Item item = items_.back();
+                items_.pop_back();
+                return item;
+            }
+
+            Key GetTopKey() const {
+                return items_.front().first;
+            }
+
+        private:
+            std::vector<Item> items_;
+        };
+
+        // Monotone min-queue for non-negative integral keys, as Dijkstra-style searches produce them:
+        // every key pushed is at least the last key popped or peeked. Items are kept in buckets by
+        // the highest bit in which their key differs from that key; a pop that finds bucket 0 empty
+        // redistributes the lowest non-empty bucket, and each item only ever moves to lower buckets,
+        // so push and pop are O(1) and O(bits) amortized, against O(log n) compares of a binary heap.
+        template <typename Key, typename Value>
+        class RadixHeap {
+        public:
+            static_assert(std::is_integral_v<Key>, "Radix heap keys should be integral");
+
+            using Item = std::pair<Key, Value>;
+
+            void Clear() {
+                for (std::vector<Item>& bucket : buckets_) {
+                    bucket.clear();
+                }
+                last_key_ = 0;
+                size_ = 0;
+            }
+
+            bool IsEmpty() const {
+                return size_ == 0;
+            }
+
+            void Push(Key key, Value value) {
+                assert(key >= Key{} && static_cast<UnsignedKey>(key) >= last_key_);
+                buckets_[GetBucket(static_cast<UnsignedKey>(key))].push_back({ key, value });
+                ++size_;
+            }
+
+            Item Pop() {
+                Refill();
+                const Item item = buckets_[0].back();
+                buckets_[0].pop_back();
+                --size_;
+                return item;
+            }
+
+            // Peeking counts as popping for the monotonicity of later pushes
+            Key GetTopKey() const {
+                Refill();
+                return static_cast<Key>(last_key_);
+            }
+
+        private:
+            using UnsignedKey = std::make_unsigned_t<Key>;
+
+            static constexpr size_t BUCKET_COUNT = std::numeric_limits<UnsignedKey>::digits + 1;
+
+            // 0 for the last key itself, else 1 + the index of the highest differing bit
+            size_t GetBucket(UnsignedKey key) const {
+                const unsigned long long difference = key ^ last_key_;
+                if (difference == 0) {
+                    return 0;
+                }
+#if defined(__GNUC__) || defined(__clang__)
+                return std::numeric_limits<unsigned long long>::digits - __builtin_clzll(difference);
+#else
+                size_t bucket = 0;
+                for (unsigned long long rest = difference; rest != 0; rest >>= 1) {
+                    ++bucket;
+                }
+                return bucket;
+#endif
+            }
+
+            // Makes bucket 0 hold the smallest key, the queue must not be empty
+            void Refill() const {
+                if (!buckets_[0].empty()) {
+                    return;
+                }
+                size_t bucket = 1;
+                while (buckets_[bucket].empty()) {
+                    ++bucket;
+                }
+                std::vector<Item>& items = buckets_[bucket];
+                last_key_ = static_cast<UnsignedKey>(std::min_element(items.begin(), items.end(),
+                    [](const Item& lhs, const Item& rhs) { return lhs.first < rhs.first; })->first);
+                for (const Item& item : items) {
+                    buckets_[GetBucket(static_cast<UnsignedKey>(item.first))].push_back(item);
+                }
+                items.clear();
+            }
+
+            mutable std::array<std::vector<Item>, BUCKET_COUNT> buckets_;
+            mutable UnsignedKey last_key_ = 0;
+            size_t size_ = 0;
+        };
+
+        // Queue of the single-source searches: the radix heap for integral weights, a binary heap otherwise
+        template <typename Weight, typename Value>
+        using SearchQueue = std::conditional_t<std::is_integral_v<Weight>, RadixHeap<Weight, Value>, BinaryHeap<Weight, Value>>;
+
+    }  // namespace detail
+}  // namespace graph
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "graph.h"
+#include "search_queue.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace graph {
+    namespace detail {
+
+        // State of one single-source search: distances and predecessors are valid only
+        // for vertices stamped with the current search, so a reset costs O(1). Pushed keys must not
+        // drop below the last popped or peeked one, as in any Dijkstra-style search (see SearchQueue).
+        template <typename Weight>
+        struct SearchState {
+            using Queue = SearchQueue<Weight, VertexId>;
+            using QueueItem = typename Queue::Item;
+
+            explicit SearchState(size_t vertex_count)
+                : weights(vertex_count)
+                , prev_edges(vertex_count)
+                , stamps(vertex_count, 0) {
+            }
+
+            void Start() {
+                if (++stamp == 0) {
+                    std::fill(stamps.begin(), stamps.end(), 0);
+                    stamp = 1;
+                }
+                queue.Clear();
+            }
+
+            bool IsReached(VertexId vertex) const {
+                return stamps[vertex] == stamp;
+            }
+
+            void Reach(VertexId vertex, Weight weight, std::optional<EdgeId> prev_edge) {
+                stamps[vertex] = stamp;
+                weights[vertex] = weight;
+                prev_edges[vertex] = prev_edge;
+            }
+
+            void Push(Weight weight, VertexId vertex) {
+                queue.Push(weight, vertex);
+            }
+
+            QueueItem Pop() {
+                return queue.Pop();
+            }
+
+            bool IsQueueEmpty() const {
+                return queue.IsEmpty();
+            }
+
+            Weight GetQueueTopWeight() const {
+                return queue.GetTopKey();
+            }
+
+            std::vector<Weight> weights;
+            std::vector<std::optional<EdgeId>> prev_edges;
+            std::vector<uint32_t> stamps;
+            Queue queue;
+            uint32_t stamp = 0;
+        };
+
+        // Hands out workspaces to concurrently running queries and takes them back afterwards,
+        // so steady-state queries don't allocate
+        template <typename Workspace>
+        class WorkspacePool {
+        public:
+            class Holder {
+            public:
+                Holder(const WorkspacePool& pool, std::unique_ptr<Workspace> workspace)
+                    : pool_(pool)
+                    , workspace_(std::move(workspace)) {
+                }
+
+                Holder(const Holder&) = delete;
+                Holder& operator=(const Holder&) = delete;
+
+                ~Holder() {
+                    pool_.Release(std::move(workspace_));
+                }
+
+                Workspace& operator*() const {
+                    return *workspace_;
+                }
+
+                Workspace* operator->() const {
+                    return workspace_.get();
+                }
+
+            private:
+                const WorkspacePool& pool_;
+                std::unique_ptr<Workspace> workspace_;
+            };
+
+            template <typename... Args>
+            Holder Acquire(Args&&... args) const {
+                std::unique_ptr<Workspace> workspace;
+                {
+                    std::lock_guard lock(mutex_);
+                    if (!free_workspaces_.empty()) {
+                        workspace = std::move(free_workspaces_.back());
+                        free_workspaces_.pop_back();
+                    }
+                }
+                if (!workspace) {
+                    workspace = std::make_unique<Workspace>(std::forward<Args>(args)...);
+                }
+                return Holder(*this, std::move(workspace));
+            }
+
+        private:
+            void Release(std::unique_ptr<Workspace> workspace) const {
+                std::lock_guard lock(mutex_);
+                free_workspaces_.push_back(std::move(workspace));
+            }
+
+            mutable std::mutex mutex_;
+            mutable std::vector<std::unique_ptr<Workspace>> free_workspaces_;
+        };
+
+    }  // namespace detail
+}  // namespace graph
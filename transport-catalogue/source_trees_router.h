@@ -0,0 +1,167 @@
+#pragma once
+
+#include "dijkstra_router.h"
+#include "graph.h"
+#include "parallel.h"
+#include "router.h"
+#include "search_workspace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+    // Engine for a batch of queries known in advance: the constructor grows a full shortest path tree
+    // from each of the given sources, and a query from a source walks its tree. S sources cost S
+    // searches and S x V cells instead of the V x V all-pairs table. Queries from other vertices
+    // are answered by an on-demand search.
+    template <typename Weight>
+    class SourceTreesRouter : public RouterBase<Weight> {
+    private:
+        using Graph = DirectedWeightedGraph<Weight>;
+
+    public:
+        using RouteInfo = typename RouterBase<Weight>::RouteInfo;
+
+        // Trees are grown on `thread_count` workers (0 means one per hardware thread). Duplicate
+        // sources are built once.
+        SourceTreesRouter(const Graph& graph, std::vector<VertexId> sources, size_t thread_count = 1);
+
+        std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+        // Tree lookups from a source, one search for all targets otherwise
+        std::vector<std::optional<Weight>> GetRouteWeights(VertexId from,
+            const std::vector<VertexId>& targets) const override;
+
+        // Sorted, without duplicates
+        const std::vector<VertexId>& GetSources() const {
+            return sources_;
+        }
+
+        // Bytes held by the trees
+        size_t GetMemoryUsage() const {
+            return weights_.capacity() * sizeof(Weight) + prev_edges_.capacity() * sizeof(uint32_t)
+                + tree_indices_.capacity() * sizeof(uint32_t);
+        }
+
+    private:
+        static constexpr Weight UNREACHABLE = std::numeric_limits<Weight>::has_infinity
+            ? std::numeric_limits<Weight>::infinity() : std::numeric_limits<Weight>::max();
+        static constexpr uint32_t NO_EDGE = std::numeric_limits<uint32_t>::max();
+        static constexpr uint32_t NO_TREE = std::numeric_limits<uint32_t>::max();
+
+        size_t GetCellIndex(uint32_t tree, VertexId vertex) const {
+            return tree * graph_.GetVertexCount() + vertex;
+        }
+
+        const Graph& graph_;
+        DijkstraRouter<Weight> on_demand_router_;
+        std::vector<VertexId> sources_;
+        // Tree of each vertex, NO_TREE for vertices that aren't sources
+        std::vector<uint32_t> tree_indices_;
+        // Tree-major S x V tables
+        std::vector<Weight> weights_;
+        std::vector<uint32_t> prev_edges_;
+    };
+
+    template <typename Weight>
+    SourceTreesRouter<Weight>::SourceTreesRouter(const Graph& graph, std::vector<VertexId> sources, size_t thread_count)
+        : graph_(graph)
+        , on_demand_router_(graph)
+        , sources_(std::move(sources))
+    {
+        const size_t vertex_count = graph.GetVertexCount();
+        if (graph.GetEdgeCount() >= NO_EDGE) {
+            throw std::length_error("Too many edges for 32-bit tree edge ids");
+        }
+        std::sort(sources_.begin(), sources_.end());
+        sources_.erase(std::unique(sources_.begin(), sources_.end()), sources_.end());
+        if (!sources_.empty() && sources_.back() >= vertex_count) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+
+        tree_indices_.assign(vertex_count, NO_TREE);
+        for (uint32_t tree = 0; tree < sources_.size(); ++tree) {
+            tree_indices_[sources_[tree]] = tree;
+        }
+        weights_.assign(sources_.size() * vertex_count, UNREACHABLE);
+        prev_edges_.assign(sources_.size() * vertex_count, NO_EDGE);
+
+        detail::WorkspacePool<detail::SearchState<Weight>> states;
+        parallel::ForEachIndex(sources_.size(), thread_count, [&](size_t tree) {
+            const auto holder = states.Acquire(vertex_count);
+            detail::SearchState<Weight>& state = *holder;
+            detail::ComputeAllWeightsFrom([&](VertexId vertex) { return graph.GetAdjacency(vertex); },
+                state, sources_[tree]);
+
+            const size_t row = GetCellIndex(static_cast<uint32_t>(tree), 0);
+            for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+                if (state.IsReached(vertex)) {
+                    weights_[row + vertex] = state.weights[vertex];
+                    if (state.prev_edges[vertex]) {
+                        prev_edges_[row + vertex] = static_cast<uint32_t>(*state.prev_edges[vertex]);
+                    }
+                }
+            }
+        });
+    }
+
+    template <typename Weight>
+    std::optional<typename SourceTreesRouter<Weight>::RouteInfo> SourceTreesRouter<Weight>::BuildRoute(VertexId from,
+        VertexId to) const {
+        const size_t vertex_count = graph_.GetVertexCount();
+        if (from >= vertex_count || to >= vertex_count) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        const uint32_t tree = tree_indices_[from];
+        if (tree == NO_TREE) {
+            return on_demand_router_.BuildRoute(from, to);
+        }
+
+        const size_t row = GetCellIndex(tree, 0);
+        if (weights_[row + to] == UNREACHABLE) {
+            return std::nullopt;
+        }
+        std::vector<EdgeId> edges;
+        for (uint32_t edge_id = prev_edges_[row + to];
+            edge_id != NO_EDGE;
+            edge_id = prev_edges_[row + graph_.GetEdge(edge_id).from])
+        {
+            edges.push_back(edge_id);
+        }
+        std::reverse(edges.begin(), edges.end());
+
+        return RouteInfo{ weights_[row + to], std::move(edges) };
+    }
+
+    template <typename Weight>
+    std::vector<std::optional<Weight>> SourceTreesRouter<Weight>::GetRouteWeights(VertexId from,
+        const std::vector<VertexId>& targets) const {
+        const size_t vertex_count = graph_.GetVertexCount();
+        if (from >= vertex_count) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        const uint32_t tree = tree_indices_[from];
+        if (tree == NO_TREE) {
+            return on_demand_router_.GetRouteWeights(from, targets);
+        }
+
+        const size_t row = GetCellIndex(tree, 0);
+        std::vector<std::optional<Weight>> weights;
+        weights.reserve(targets.size());
+        for (const VertexId to : targets) {
+            if (to >= vertex_count) {
+                throw std::out_of_range("Vertex id is out of range");
+            }
+            const Weight weight = weights_[row + to];
+            weights.push_back(weight == UNREACHABLE ? std::nullopt : std::optional<Weight>(weight));
+        }
+        return weights;
+    }
+
+}  // namespace graph
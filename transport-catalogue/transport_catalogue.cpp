@@ -1,4 +1,6 @@
 
+#include <algorithm>
+#include <limits>
 #include <stdexcept>
 #include <string>
 #include <string_view>
@@ -10,6 +12,7 @@
 #include "domain.h"
 #include "string_view"
 #include "geo.h"
+#include "parallel.h"
 
 #include "transport_catalogue.h"
 
@@ -19,12 +22,16 @@ using namespace transport_catalogue::domain;
 
 namespace transport_catalogue {
 	void TransportCatalogue::AddBus(const std::string& busname) {
-		buses_.push_back(std::move(Bus(busname)));
+		buses_.push_back(Bus(busname, static_cast<BusId>(buses_.size())));
 		busname_to_bus_[buses_.back().name_] = &buses_.back();
+		bus_stats_.emplace_back();
+		is_bus_stats_valid_.push_back(0);
 	}
 
 	void TransportCatalogue::SetBusRouteType(std::string_view busname, RouteType type) {
-		busname_to_bus_[busname]->route_type_ = type;
+		Bus* bus = busname_to_bus_.at(busname);
+		bus->route_type_ = type;
+		InvalidateBusStats(bus->id_);
 	}
 
 	const Bus* TransportCatalogue::GetBusByName(std::string_view busname) const {
@@ -34,16 +41,30 @@ namespace transport_catalogue {
 		return busname_to_bus_.at(busname);
 	}
 
+	const Bus* TransportCatalogue::GetBus(BusId id) const {
+		return &buses_.at(id);
+	}
+
 	void TransportCatalogue::AddStop(const std::string& stopname, geo::Coordinates coords) {
-		stops_.push_back({ stopname, coords });
+		stops_.push_back({ stopname, static_cast<StopId>(stops_.size()) });
 		stopname_to_stop_[stops_.back().name_] = &stops_.back();
-		stop_to_busnames_[stops_.back().name_];
+		stop_coordinates_.push_back(coords);
+		stop_busnames_.emplace_back();
+		stop_distances_.emplace_back();
 	}
 
 	const Stop* TransportCatalogue::GetStopByName(std::string_view stopname) const {
 		return stopname_to_stop_.at(stopname);
 	}
 
+	const Stop* TransportCatalogue::GetStop(StopId id) const {
+		return &stops_.at(id);
+	}
+
+	const geo::Coordinates& TransportCatalogue::GetStopCoordinates(StopId id) const {
+		return stop_coordinates_.at(id);
+	}
+
 	const std::unordered_map<std::string_view, Bus*>& TransportCatalogue::GetBuses() const {
 		return busname_to_bus_;
 	}
@@ -57,17 +78,19 @@ namespace transport_catalogue {
 		Bus* bus = busname_to_bus_.at(busname);
 		Stop* stop = stopname_to_stop_.at(stopname);
 
-		bus->stops_.push_back(stop);
+		bus->stop_ids_.push_back(stop->id_);
+		InvalidateBusStats(bus->id_);
 
-		stop_to_busnames_[stopname].insert(bus->name_);
+		stop_busnames_[stop->id_].insert(bus->name_);
 	}
 
 	std::vector<std::string_view> TransportCatalogue::GetBusnamesForStop(std::string_view stopname) const {
-		std::vector<std::string_view> res;
-		for (auto bus : stop_to_busnames_.at(stopname)) {
-			res.push_back(bus);
-		}
-		return res;
+		return GetBusnamesForStop(stopname_to_stop_.at(stopname)->id_);
+	}
+
+	std::vector<std::string_view> TransportCatalogue::GetBusnamesForStop(StopId id) const {
+		const auto& busnames = stop_busnames_.at(id);
+		return { busnames.begin(), busnames.end() };
 	}
 
 	void TransportCatalogue::SetRoutingSettings(RoutingSettings&& settings) {
@@ -78,77 +101,123 @@ namespace transport_catalogue {
 		return routing_settings_;
 	}
 
-	double TransportCatalogue::GetRouteLength(std::string_view busname) const {
-		double result = 0;
-		const auto* bus = busname_to_bus_.at(busname);
-
-		for (size_t i = 0; i < bus->stops_.size() - 1; i++) {
-			result += GetDistance(bus->stops_[i]->name_, bus->stops_[i + 1]->name_);
-		}
-		if (bus->route_type_ == RouteType::DIRECT) {
-			for (size_t i = bus->stops_.size() - 1; i > 0; i--) {
-				result += GetDistance(bus->stops_[i]->name_, bus->stops_[i - 1]->name_);
+	void TransportCatalogue::UpdateBusStats() {
+		std::vector<BusId> stale_buses;
+		for (BusId id = 0; id < buses_.size(); ++id) {
+			if (!is_bus_stats_valid_[id]) {
+				stale_buses.push_back(id);
 			}
 		}
-		
-		return result;
+		parallel::ForEachIndex(stale_buses.size(), parallel::GetDefaultThreadCount(), [&](size_t i) {
+			bus_stats_[stale_buses[i]] = ComputeBusStats(buses_[stale_buses[i]]);
+		});
+		for (const BusId id : stale_buses) {
+			is_bus_stats_valid_[id] = 1;
+		}
 	}
 
-	double TransportCatalogue::GetGeoRouteLength(std::string_view busname) const {
-		double result = 0;
-		const auto* bus = busname_to_bus_.at(busname);
+	BusStats TransportCatalogue::GetBusStats(std::string_view busname) const {
+		return GetBusStats(busname_to_bus_.at(busname)->id_);
+	}
 
-		for (size_t i = 0; i < bus->stops_.size() - 1; i++) {
-			result += geo::ComputeDistance(bus->stops_[i]->coords_, bus->stops_[i + 1]->coords_);
-		}
-		if (bus->route_type_ == RouteType::DIRECT) {
-			for (size_t i = bus->stops_.size() - 1; i > 0; i--) {
-				result += geo::ComputeDistance(bus->stops_[i]->coords_, bus->stops_[i - 1]->coords_);
-			}
+	BusStats TransportCatalogue::GetBusStats(BusId id) const {
+		if (is_bus_stats_valid_.at(id)) {
+			return bus_stats_[id];
 		}
-		return result;
+		return ComputeBusStats(buses_[id]);
+	}
+
+	double TransportCatalogue::GetRouteLength(std::string_view busname) const {
+		return GetBusStats(busname).route_length;
+	}
+
+	double TransportCatalogue::GetGeoRouteLength(std::string_view busname) const {
+		return GetBusStats(busname).geo_length;
 	}
 
 	double TransportCatalogue::GetRouteCurvature(std::string_view busname) const {
-		double fact_length = GetRouteLength(busname);
-		double geo_length = GetGeoRouteLength(busname);
-		return (fact_length / geo_length);
+		return GetBusStats(busname).curvature;
 	}
 
 	size_t TransportCatalogue::GetStopCount(std::string_view busname) const {
-		auto* bus = busname_to_bus_.at(busname);
-		size_t res = bus->stops_.size();
-		if (bus->route_type_ == RouteType::DIRECT) {
-			res = res * 2 - 1;
-		}
-		return res;
+		return GetBusStats(busname).stop_count;
 	}
 
 	size_t TransportCatalogue::GetUniqueStopsCount(std::string_view busname) const {
-		const Bus* bus_p = busname_to_bus_.at(busname);
-		std::unordered_set<std::string_view> count;
-		for (auto stop : bus_p->stops_) {
-			count.insert(stop->name_);
+		return GetBusStats(busname).unique_stop_count;
+	}
+
+	BusStats TransportCatalogue::ComputeBusStats(const Bus& bus) const {
+		BusStats stats;
+		const auto& stop_ids = bus.stop_ids_;
+		const bool is_direct = bus.route_type_ == RouteType::DIRECT;
+
+		for (size_t i = 0; i + 1 < stop_ids.size(); i++) {
+			stats.route_length += GetDistance(stop_ids[i], stop_ids[i + 1]);
+			stats.geo_length += geo::ComputeDistance(stop_coordinates_[stop_ids[i]], stop_coordinates_[stop_ids[i + 1]]);
+		}
+		if (is_direct) {
+			for (size_t i = stop_ids.size(); i > 1; i--) {
+				stats.route_length += GetDistance(stop_ids[i - 1], stop_ids[i - 2]);
+				stats.geo_length += geo::ComputeDistance(stop_coordinates_[stop_ids[i - 1]], stop_coordinates_[stop_ids[i - 2]]);
+			}
 		}
-		return count.size();
+		stats.curvature = stats.route_length / stats.geo_length;
+
+		stats.stop_count = is_direct ? stop_ids.size() * 2 - 1 : stop_ids.size();
+		std::vector<StopId> unique_stop_ids = stop_ids;
+		std::sort(unique_stop_ids.begin(), unique_stop_ids.end());
+		stats.unique_stop_count = std::unique(unique_stop_ids.begin(), unique_stop_ids.end()) - unique_stop_ids.begin();
+		return stats;
+	}
+
+	void TransportCatalogue::InvalidateBusStats(BusId id) {
+		is_bus_stats_valid_[id] = 0;
 	}
 
 	void TransportCatalogue::SetDistance(std::string_view stopname1, std::string_view stopname2, double distance) {
-		Stop* bus1 = stopname_to_stop_[stopname1];
-		Stop* bus2 = stopname_to_stop_[stopname2];
-		if (stops_to_distance_.count({ bus1, bus2 }) == 1) {
-			stops_to_distance_[{bus1, bus2}] = distance;
+		SetDistance(stopname_to_stop_.at(stopname1)->id_, stopname_to_stop_.at(stopname2)->id_, distance);
+	}
+
+	void TransportCatalogue::SetDistance(StopId from, StopId to, double distance) {
+		// Every bus riding the road between the two stops stops at `from`
+		for (std::string_view busname : stop_busnames_.at(from)) {
+			InvalidateBusStats(busname_to_bus_.at(busname)->id_);
 		}
-		else {
-			stops_to_distance_[{bus1, bus2}] = distance;
-			stops_to_distance_[{bus2, bus1}] = distance;
+
+		const bool is_set = FindDistance(from, to) != nullptr;
+		InsertDistance(from, to, static_cast<int>(distance));
+		if (!is_set) {
+			InsertDistance(to, from, static_cast<int>(distance));
 		}
 	}
 
 	int TransportCatalogue::GetDistance(std::string_view stopname1, std::string_view stopname2) const {
-		Stop* bus1 = stopname_to_stop_.at(stopname1);
-		Stop* bus2 = stopname_to_stop_.at(stopname2);
-		return stops_to_distance_.at({ bus1, bus2 });
+		return GetDistance(stopname_to_stop_.at(stopname1)->id_, stopname_to_stop_.at(stopname2)->id_);
+	}
+
+	int TransportCatalogue::GetDistance(StopId from, StopId to) const {
+		if (const int* distance = FindDistance(from, to)) {
+			return *distance;
+		}
+		throw std::out_of_range("Unknown road distance");
+	}
+
+	const int* TransportCatalogue::FindDistance(StopId from, StopId to) const {
+		const std::vector<StopDistance>& row = stop_distances_.at(from);
+		const auto it = std::lower_bound(row.begin(), row.end(), StopDistance{ to, std::numeric_limits<int>::min() });
+		return it != row.end() && it->first == to ? &it->second : nullptr;
+	}
+
+	void TransportCatalogue::InsertDistance(StopId from, StopId to, int distance) {
+		std::vector<StopDistance>& row = stop_distances_.at(from);
+		const auto it = std::lower_bound(row.begin(), row.end(), StopDistance{ to, std::numeric_limits<int>::min() });
+		if (it != row.end() && it->first == to) {
+			it->second = distance;
+		}
+		else {
+			row.insert(it, { to, distance });
+		}
 	}
 
 	namespace detail {
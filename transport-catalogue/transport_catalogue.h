@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <deque>
 #include <set>
 #include <string>
@@ -30,7 +31,18 @@ namespace transport_catalogue {
 		void SetBusRouteType(std::string_view busname, domain::RouteType type);
 
 		const domain::Bus* GetBusByName(std::string_view busname) const;
-
+		// Ids are dense: 0 <= id < GetBuses().size()
+		const domain::Bus* GetBus(domain::BusId id) const;
+
+		// Computes the stats of the buses added or changed since the last call, on the worker pool.
+		// Called once loading is done, and again after edits.
+		void UpdateBusStats();
+		// A table lookup for the buses UpdateBusStats covered, computed on the spot for the others.
+		// Throws std::out_of_range for an unknown bus.
+		domain::BusStats GetBusStats(std::string_view busname) const;
+		domain::BusStats GetBusStats(domain::BusId id) const;
+
+		// Fields of GetBusStats
 		double GetRouteLength(std::string_view busname) const;
 		double GetGeoRouteLength(std::string_view busname) const;
 		double GetRouteCurvature(std::string_view busname) const;
@@ -40,38 +52,56 @@ namespace transport_catalogue {
 
 		void AddStop(const std::string& stopname, geo::Coordinates coords);
 		const domain::Stop* GetStopByName(std::string_view stopname) const;
+		// Ids are dense: 0 <= id < GetStops().size()
+		const domain::Stop* GetStop(domain::StopId id) const;
+		const geo::Coordinates& GetStopCoordinates(domain::StopId id) const;
 
 		const std::unordered_map<std::string_view, domain::Bus*>& GetBuses() const;
 		const std::unordered_map<std::string_view, domain::Stop*>& GetStops() const;
 
 		void AddStopForBus(std::string_view busname, std::string_view stopname);
 		std::vector<std::string_view> GetBusnamesForStop(std::string_view stopname) const;
+		std::vector<std::string_view> GetBusnamesForStop(domain::StopId id) const;
 
 		void SetRoutingSettings(RoutingSettings&& settings);
 		RoutingSettings GetRoutingSettings() const;
 
+		// Sets the distance from the first stop to the second one, and back unless that was set before
 		void SetDistance(std::string_view stopname1, std::string_view stopname2, double distance);
+		void SetDistance(domain::StopId from, domain::StopId to, double distance);
+		// Throws std::out_of_range when the distance is unknown
 		int GetDistance(std::string_view stopname1, std::string_view stopname2) const;
+		int GetDistance(domain::StopId from, domain::StopId to) const;
 
 	private:
+		using StopDistance = std::pair<domain::StopId, int>;
+
+		// Distance from `from` to `to` in the sorted row of `from`, nullptr when unknown
+		const int* FindDistance(domain::StopId from, domain::StopId to) const;
+		void InsertDistance(domain::StopId from, domain::StopId to, int distance);
 
-		struct StopPairHash {
-			size_t operator() (std::pair<domain::Stop*, domain::Stop*> stop_pair) const {
-				static const int x = 43;
-				return std::hash<std::string>{}(stop_pair.first->name_) + std::hash<std::string>{}(stop_pair.second->name_)* x;
-			}
-		};
+		domain::BusStats ComputeBusStats(const domain::Bus& bus) const;
+		// Stats of `id` have to be recomputed by the next UpdateBusStats
+		void InvalidateBusStats(domain::BusId id);
 
 		RoutingSettings routing_settings_;
 
+		// Indexed by id. Deques keep the objects, and the names the maps below point to, in place as
+		// they grow; the rest of the per-stop data is in plain arrays.
 		std::deque<domain::Bus> buses_;
 		std::deque<domain::Stop> stops_;
+		std::vector<geo::Coordinates> stop_coordinates_;
+		std::vector<std::set<std::string_view>> stop_busnames_;
+		// Road distances from each stop, sorted by the stop they lead to: a lookup is a binary search
+		// in a row of a few entries rather than hashing
+		std::vector<std::vector<StopDistance>> stop_distances_;
+		// Indexed by bus id; an entry is used only while its flag is set
+		std::vector<domain::BusStats> bus_stats_;
+		std::vector<uint8_t> is_bus_stats_valid_;
 
 		std::unordered_map<std::string_view, domain::Bus*> busname_to_bus_;
 		std::unordered_map<std::string_view, domain::Stop*> stopname_to_stop_;
 
-		std::unordered_map<std::pair<domain::Stop*, domain::Stop*>, int, StopPairHash> stops_to_distance_;
-		std::unordered_map<std::string_view, std::set<std::string_view>> stop_to_busnames_;
 	};
 
 	namespace detail {
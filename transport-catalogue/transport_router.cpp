@@ -1,79 +1,444 @@
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include "geo.h"
+#include "line_router.h"
+#include "parallel.h"
 #include "transport_router.h"
 #include "transport_catalogue.h"
 
 
 using namespace transport_graph;
 
+namespace {
 
+	// Farthest-point traversal over the coordinates of the stops served by buses: starts from the stop
+	// farthest from their centre, then repeatedly takes the stop farthest from every landmark so far.
+	// Returns transfer vertices, the ones routes start and end at.
+	std::vector<graph::VertexId> SelectLandmarks(const TransportGraph& transport_graph, size_t count) {
+		const auto& graph = transport_graph.GetGraph();
+		const auto& stop_vertex_ids = transport_graph.GetStopVertexIds();
+		std::vector<std::pair<graph::VertexId, geo::Coordinates>> candidates;
+		for (domain::StopId stop_id = 0; stop_id < stop_vertex_ids.size(); ++stop_id) {
+			const VertexIdLoop& vertex_id = stop_vertex_ids[stop_id];
+			if (vertex_id.id != TransportGraph::NO_VERTEX && graph.GetAdjacency(vertex_id.id).size > 0) {
+				candidates.push_back({ vertex_id.transfer_id, transport_graph.GetCatalogue().GetStopCoordinates(stop_id) });
+			}
+		}
+		if (candidates.empty()) {
+			return {};
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const auto& lhs, const auto& rhs) {
+			return lhs.first < rhs.first;
+		});
+
+		geo::Coordinates centre{};
+		for (const auto& [vertex, coords] : candidates) {
+			centre.lat += coords.lat / candidates.size();
+			centre.lng += coords.lng / candidates.size();
+		}
+		std::vector<double> distances(candidates.size());
+		for (size_t i = 0; i < candidates.size(); ++i) {
+			distances[i] = geo::ComputeDistance(centre, candidates[i].second);
+		}
 
-void TransportGraph::SetVertex(const TransportCatalogue& catalogue) {
-	const auto& stops = catalogue.GetStops();
+		std::vector<graph::VertexId> landmarks;
+		while (landmarks.size() < std::min(count, candidates.size())) {
+			const size_t next = std::max_element(distances.begin(), distances.end()) - distances.begin();
+			landmarks.push_back(candidates[next].first);
+			for (size_t i = 0; i < candidates.size(); ++i) {
+				const double distance = geo::ComputeDistance(candidates[next].second, candidates[i].second);
+				distances[i] = landmarks.size() == 1 ? distance : std::min(distances[i], distance);
+			}
+			distances[next] = -1.0;
+		}
+		return landmarks;
+	}
+
+	// Sorts by stop pair and leaves the winner of every pair first, returns the end of the winners
+	BusEdges::iterator SortUniqueBusEdges(BusEdges& edges) {
+		std::sort(edges.begin(), edges.end(), [](const BusEdge& lhs, const BusEdge& rhs) {
+			if (std::tie(lhs.from, lhs.to, lhs.data.time) != std::tie(rhs.from, rhs.to, rhs.data.time)) {
+				return std::tie(lhs.from, lhs.to, lhs.data.time) < std::tie(rhs.from, rhs.to, rhs.data.time);
+			}
+			return std::tie(lhs.data.bus->name_, lhs.data.stop_count) < std::tie(rhs.data.bus->name_, rhs.data.stop_count);
+		});
+		return std::unique(edges.begin(), edges.end(), [](const BusEdge& lhs, const BusEdge& rhs) {
+			return lhs.from == rhs.from && lhs.to == rhs.to;
+		});
+	}
+
+}
+
+
+// Vertices in stop id order
+void TransportGraph::SetVertex() {
+	const size_t stop_count = catalogue_.GetStops().size();
+	stop_vertex_ids_.assign(stop_count, VertexIdLoop{ NO_VERTEX, NO_VERTEX });
 	graph::VertexId id{};
-	for (const auto& [stopname, stop_ptr] : stops) {
-		VertexIdLoop vertex_id{ id, id + 1 };
-		stop_to_vertex_id_.insert({ stop_ptr, vertex_id });
-		id += 2;
+	for (domain::StopId stop_id = 0; stop_id < stop_count; ++stop_id) {
+		if (model_ == GraphModel::WAIT_VERTICES) {
+			stop_vertex_ids_[stop_id] = VertexIdLoop{ id, id + 1 };
+			id += 2;
+		}
+		else if (!catalogue_.GetBusnamesForStop(stop_id).empty()) {
+			stop_vertex_ids_[stop_id] = VertexIdLoop{ id, id };
+			++id;
+		}
 	}
+	graph_ = graph::DirectedWeightedGraph<TransportTime>(id);
 }
 
-void TransportGraph::CreateDiagonalEdges(const TransportCatalogue& catalogue) {
-	const auto time = catalogue.GetRoutingSettings().bus_wait_time;
-	for (const auto [stop_ptr, vertex_id] : stop_to_vertex_id_ ) {
-		graph::EdgeId id = graph_.AddEdge({ vertex_id.transfer_id, vertex_id.id, time });
-		edge_id_to_graph_data_.insert({ id, TransportGraphData{ stop_ptr, stop_ptr, nullptr, 0, time } });
+void TransportGraph::IndexTransferVertices() {
+	transfer_vertex_to_stop_.assign(graph_.GetVertexCount(), nullptr);
+	for (domain::StopId stop_id = 0; stop_id < stop_vertex_ids_.size(); ++stop_id) {
+		if (stop_vertex_ids_[stop_id].id != NO_VERTEX) {
+			transfer_vertex_to_stop_[stop_vertex_ids_[stop_id].transfer_id] = catalogue_.GetStop(stop_id);
+		}
 	}
 }
 
-void  TransportGraph::CreateGraph(const TransportCatalogue& catalogue) {
-	const auto& buses = catalogue.GetBuses();
-	EdgesData edges;
-	for (const auto& [busname, bus_ptr] : buses) {
-		CreateEdges(edges, CreateTransportGraphData(ranges::AsBusRangeDirect(bus_ptr), catalogue));
+void TransportGraph::CreateDiagonalEdges() {
+	for (domain::StopId stop_id = 0; stop_id < stop_vertex_ids_.size(); ++stop_id) {
+		const VertexIdLoop& vertex_id = stop_vertex_ids_[stop_id];
+		const domain::Stop* stop_ptr = catalogue_.GetStop(stop_id);
+		graph::EdgeId id = graph_.AddEdge({ vertex_id.transfer_id, vertex_id.id, wait_time_ });
+		edge_id_to_graph_data_.push_back(TransportGraphData{ stop_ptr, stop_ptr, nullptr, 0, wait_time_ });
+		assert(id + 1 == edge_id_to_graph_data_.size());
+	}
+}
 
-		if (bus_ptr->route_type_ == domain::RouteType::DIRECT) {
-			CreateEdges(edges, CreateTransportGraphData(ranges::AsBusRangeReversed(bus_ptr), catalogue));
-		}
+// Buses are independent: each one writes its edges to its own slice of one array on the worker pool
+void  TransportGraph::CreateGraph() {
+	const size_t bus_count = catalogue_.GetBuses().size();
+	std::vector<size_t> offsets{ 0 };
+	for (domain::BusId bus_id = 0; bus_id < bus_count; ++bus_id) {
+		offsets.push_back(offsets.back() + CountBusEdges(catalogue_.GetBus(bus_id)));
 	}
+
+	BusEdges edges(offsets.back());
+	parallel::ForEachIndex(bus_count, parallel::GetDefaultThreadCount(), [&](size_t i) {
+		[[maybe_unused]] BusEdge* out = CreateBusEdges(catalogue_.GetBus(static_cast<domain::BusId>(i)), edges.data() + offsets[i]);
+		assert(out == edges.data() + offsets[i + 1]);
+	});
 	AddEdgesToGraph(edges);
 }
 
-void TransportGraph::CreateEdges(EdgesData& edges, std::vector<TransportGraphData>&& data) {
-	for (TransportGraphData& data_i : data) {
-		graph::VertexId from = stop_to_vertex_id_.at(data_i.stop_from).id;
-		graph::VertexId to = stop_to_vertex_id_.at(data_i.stop_to).transfer_id;
+BusEdge* TransportGraph::CreateBusEdges(const domain::Bus* bus, BusEdge* out) const {
+	out = CreateTransportGraphData(ranges::AsBusRangeDirect(bus), out);
+	if (bus->route_type_ == domain::RouteType::DIRECT) {
+		out = CreateTransportGraphData(ranges::AsBusRangeReversed(bus), out);
+	}
+	return out;
+}
+
+// Every pair of stops of a direction except pairs of the same stop
+size_t TransportGraph::CountBusEdges(const domain::Bus* bus) {
+	const size_t stop_count = bus->stop_ids_.size();
+	size_t edge_count = stop_count * (stop_count - std::min<size_t>(stop_count, 1)) / 2;
 
-		if (edges.count(from) > 0 && edges.at(from).count(to) > 0) {
-			if (edges.at(from).at(to).time > data_i.time) {
-				edges.at(from).at(to) = std::move(data_i);
+	std::unordered_map<domain::StopId, size_t> visit_counts;
+	for (const domain::StopId stop_id : bus->stop_ids_) {
+		edge_count -= visit_counts[stop_id]++;
+	}
+	return bus->route_type_ == domain::RouteType::DIRECT ? edge_count * 2 : edge_count;
+}
+
+// Sort-and-unique pass: of the edges between the same pair of vertices only the fastest one is kept,
+// ties going to the bus with the smallest name and span, so the graph and its EdgeIds don't depend on scheduling
+void TransportGraph::AddEdgesToGraph(BusEdges& edges) {
+	const auto unique_end = SortUniqueBusEdges(edges);
+
+	edge_id_to_graph_data_.reserve(edge_id_to_graph_data_.size() + (unique_end - edges.begin()));
+	for (auto it = edges.begin(); it != unique_end; ++it) {
+		graph::EdgeId id = graph_.AddEdge({ it->from, it->to, GetEdgeWeight(it->data) });
+		edge_id_to_graph_data_.push_back(it->data);
+		assert(id + 1 == edge_id_to_graph_data_.size());
+	}
+}
+
+TransportGraph::TransportGraph(const TransportGraph& previous, const std::vector<domain::Bus*>& changed_buses)
+	:catalogue_(previous.catalogue_), model_(previous.model_), wait_time_(previous.wait_time_)
+	, edge_id_to_graph_data_(previous.edge_id_to_graph_data_), stop_vertex_ids_(previous.stop_vertex_ids_) {
+	graph::VertexId vertex_count = previous.graph_.GetVertexCount();
+	if (catalogue_.GetStops().size() != stop_vertex_ids_.size()) {
+		throw std::invalid_argument("Stops can't be added to an existing graph");
+	}
+	if (model_ == GraphModel::COMPACT) {
+		for (const domain::Bus* bus_ptr : changed_buses) {
+			for (const domain::StopId stop_id : bus_ptr->stop_ids_) {
+				if (stop_vertex_ids_[stop_id].id == NO_VERTEX) {
+					stop_vertex_ids_[stop_id] = VertexIdLoop{ vertex_count, vertex_count };
+					++vertex_count;
+				}
 			}
 		}
-		else {
-			edges[from].emplace(to, std::move(data_i));
-		}
 	}
+	graph_ = graph::DirectedWeightedGraph<TransportTime>(vertex_count);
+	IndexTransferVertices();
+	UpdateBusEdges(previous.graph_, changed_buses);
+	graph_.Freeze();
 }
 
-void TransportGraph::AddEdgesToGraph(EdgesData& edges) {
-	for (auto& [from, to_map] : edges) {
-		for (auto& [to, data_i] : to_map) {
-			graph::EdgeId id = graph_.AddEdge({ from, to, data_i.time });
-			edge_id_to_graph_data_.emplace(id, std::move(data_i));
+// The winner of a stop pair served by a changed bus may now be any bus serving that pair, so the pairs
+// are re-decided from the candidates of every bus through their first stops. Stop pairs never go away:
+// buses can only be added.
+void TransportGraph::UpdateBusEdges(const graph::DirectedWeightedGraph<TransportTime>& previous_graph, const std::vector<domain::Bus*>& changed_buses) {
+	const size_t vertex_count = graph_.GetVertexCount();
+	const auto get_pair_key = [vertex_count](graph::VertexId from, graph::VertexId to) {
+		return from * vertex_count + to;
+	};
+
+	std::unordered_set<const domain::Bus*> candidate_buses(changed_buses.begin(), changed_buses.end());
+	BusEdges edges;
+	for (domain::Bus* bus_ptr : changed_buses) {
+		const size_t offset = edges.size();
+		edges.resize(offset + CountBusEdges(bus_ptr));
+		CreateBusEdges(bus_ptr, edges.data() + offset);
+	}
+	std::unordered_set<size_t> dirty_pairs;
+	std::unordered_set<const domain::Stop*> dirty_stops_from;
+	for (const BusEdge& edge : edges) {
+		dirty_pairs.insert(get_pair_key(edge.from, edge.to));
+		dirty_stops_from.insert(edge.data.stop_from);
+	}
+
+	for (const domain::Stop* stop : dirty_stops_from) {
+		for (std::string_view busname : catalogue_.GetBusnamesForStop(stop->id_)) {
+			domain::Bus* bus_ptr = catalogue_.GetBuses().at(busname);
+			if (!candidate_buses.insert(bus_ptr).second) {
+				continue;
+			}
+			BusEdges bus_edges(CountBusEdges(bus_ptr));
+			CreateBusEdges(bus_ptr, bus_edges.data());
+			for (const BusEdge& edge : bus_edges) {
+				if (dirty_pairs.count(get_pair_key(edge.from, edge.to)) > 0) {
+					edges.push_back(edge);
+				}
+			}
+		}
+	}
+	const auto unique_end = SortUniqueBusEdges(edges);
+
+	std::unordered_map<size_t, graph::EdgeId> pair_to_edge_id;
+	for (const domain::Stop* stop : dirty_stops_from) {
+		const graph::VertexId from = stop_vertex_ids_[stop->id_].id;
+		if (from >= previous_graph.GetVertexCount()) {
+			continue;
+		}
+		const graph::AdjacencySpan<TransportTime> adjacency = previous_graph.GetAdjacency(from);
+		for (size_t i = 0; i < adjacency.size; ++i) {
+			pair_to_edge_id.emplace(get_pair_key(from, adjacency.targets[i]), adjacency.edge_ids[i]);
+		}
+	}
+
+	std::vector<graph::Edge<TransportTime>> graph_edges;
+	graph_edges.reserve(previous_graph.GetEdgeCount() + (unique_end - edges.begin()));
+	for (graph::EdgeId id = 0; id < previous_graph.GetEdgeCount(); ++id) {
+		graph_edges.push_back(previous_graph.GetEdge(id));
+	}
+	for (auto it = edges.begin(); it != unique_end; ++it) {
+		const auto existing = pair_to_edge_id.find(get_pair_key(it->from, it->to));
+		if (existing == pair_to_edge_id.end()) {
+			changed_edges_.push_back(graph_edges.size());
+			graph_edges.push_back({ it->from, it->to, GetEdgeWeight(it->data) });
+			edge_id_to_graph_data_.push_back(it->data);
+			continue;
 		}
+		const graph::EdgeId id = existing->second;
+		if (graph_edges[id].weight != GetEdgeWeight(it->data)) {
+			changed_edges_.push_back(id);
+			graph_edges[id].weight = GetEdgeWeight(it->data);
+		}
+		edge_id_to_graph_data_[id] = it->data;
+	}
+
+	for (const auto& edge : graph_edges) {
+		graph_.AddEdge(edge);
+	}
+}
+
+size_t TransportGraph::GetMemoryUsage() const {
+	return sizeof(*this) + graph_.GetMemoryUsage() + edge_id_to_graph_data_.capacity() * sizeof(TransportGraphData)
+		+ stop_vertex_ids_.capacity() * sizeof(VertexIdLoop) + transfer_vertex_to_stop_.capacity() * sizeof(const domain::Stop*);
+}
+
+TransportRouter::TransportRouter(std::shared_ptr<const TransportGraph> graph, RouterType type, size_t route_cache_bytes)
+	:type_(type), transport_graph_(std::move(graph)), router_(CreateRouter(*transport_graph_, type)), route_cache_(route_cache_bytes) {
+}
+
+TransportRouter::TransportRouter(std::shared_ptr<const TransportGraph> graph, RouterType type, std::unique_ptr<graph::RouterBase<TransportTime>> router,
+	size_t route_cache_bytes)
+	:type_(type), transport_graph_(std::move(graph)), router_(std::move(router)), route_cache_(route_cache_bytes) {
+}
+
+TransportRouter::TransportRouter(const TransportCatalogue& catalogue, size_t route_cache_bytes)
+	:type_(RouterType::BUS_LINES), line_router_(std::make_unique<LineRouter>(catalogue)), route_cache_(route_cache_bytes) {
+}
+
+TransportRouter::~TransportRouter() = default;
+
+std::unique_ptr<TransportRouter> TransportRouter::Update(std::shared_ptr<const TransportGraph> graph) const {
+	if (type_ == RouterType::BUS_LINES) {
+		throw std::logic_error("Bus lines router has no graph to update");
+	}
+	std::unique_ptr<graph::RouterBase<TransportTime>> engine;
+	const bool is_vertex_count_same = graph->GetGraph().GetVertexCount() == transport_graph_->GetGraph().GetVertexCount();
+	const auto* all_pairs_router = dynamic_cast<const graph::Router<TransportTime>*>(router_.get());
+	if (all_pairs_router && is_vertex_count_same) {
+		engine = std::make_unique<graph::Router<TransportTime>>(graph->GetGraph(), *all_pairs_router, graph->GetChangedEdges(),
+			parallel::GetDefaultThreadCount());
+	}
+	else if (const auto* source_trees_router = dynamic_cast<const graph::SourceTreesRouter<TransportTime>*>(router_.get())) {
+		engine = std::make_unique<graph::SourceTreesRouter<TransportTime>>(graph->GetGraph(), source_trees_router->GetSources(),
+			parallel::GetDefaultThreadCount());
+	}
+	else {
+		return std::make_unique<TransportRouter>(std::move(graph), type_, route_cache_.GetByteBudget());
+	}
+	return std::make_unique<TransportRouter>(std::move(graph), type_, std::move(engine), route_cache_.GetByteBudget());
+}
+
+std::unique_ptr<graph::RouterBase<TransportTime>> TransportRouter::CreateRouter(const TransportGraph& transport_graph, RouterType type) {
+	const auto& graph = transport_graph.GetGraph();
+	switch (type)
+	{
+	case RouterType::ALL_PAIRS:
+		return std::make_unique<graph::Router<TransportTime>>(graph, parallel::GetDefaultThreadCount());
+	case RouterType::DIJKSTRA:
+		return std::make_unique<graph::DijkstraRouter<TransportTime>>(graph);
+	case RouterType::CONTRACTION_HIERARCHIES:
+		return std::make_unique<graph::ContractionHierarchiesRouter<TransportTime>>(graph);
+	case RouterType::BIDIRECTIONAL_DIJKSTRA:
+		return std::make_unique<graph::BidirectionalDijkstraRouter<TransportTime>>(graph);
+	case RouterType::ALT:
+		return std::make_unique<graph::AltRouter<TransportTime>>(graph,
+			SelectLandmarks(transport_graph, graph::AltRouter<TransportTime>::DEFAULT_LANDMARK_COUNT), parallel::GetDefaultThreadCount());
+	case RouterType::HUB_LABELS:
+		return std::make_unique<graph::HubLabelsRouter<TransportTime>>(graph);
+	case RouterType::SOURCE_TREES:
+		// Sources come with a ready engine; without them every query searches on demand
+		return std::make_unique<graph::SourceTreesRouter<TransportTime>>(graph, std::vector<graph::VertexId>{});
+	case RouterType::BUS_LINES:
+		throw std::invalid_argument("Bus lines model is built from the catalogue, not from the graph");
+	default:
+		throw std::invalid_argument("Unknown router type");
 	}
 }
 
 std::optional<TransportRouter::TransportRouterData> TransportRouter::GetRoute(const domain::Stop* from, const domain::Stop* to) const {
-	const auto& stop_to_vertex_id = transport_graph_.GetStopToVertexId();
-	auto route = router_.BuildRoute(stop_to_vertex_id.at(from).transfer_id, stop_to_vertex_id.at(to).transfer_id);
+	const StopPair key{ from, to };
+	if (auto cached = route_cache_.Get(key)) {
+		return std::move(*cached);
+	}
+
+	auto route = BuildRoute(from, to);
+	const size_t heap_bytes = route ? route->route.capacity() * sizeof(TransportGraphData) : 0;
+	route_cache_.Put(key, route, heap_bytes);
+	return route;
+}
+
+std::optional<TransportRouter::TransportRouterData> TransportRouter::BuildRoute(const domain::Stop* from, const domain::Stop* to) const {
+	if (line_router_) {
+		return line_router_->GetRoute(from, to);
+	}
+
+	// A stop without a vertex is served by no bus and only reaches itself
+	const VertexIdLoop* from_vertex_id = transport_graph_->FindVertexId(from);
+	const VertexIdLoop* to_vertex_id = transport_graph_->FindVertexId(to);
+	if (from_vertex_id == nullptr || to_vertex_id == nullptr) {
+		return from == to ? std::optional<TransportRouterData>(TransportRouterData{}) : std::nullopt;
+	}
+	auto route = router_->BuildRoute(from_vertex_id->transfer_id, to_vertex_id->transfer_id);
 	if (route) {
 		TransportRouterData output_data;
 		output_data.time = (*route).weight;
 
-		const auto& edge_id_to_graph_data = transport_graph_.GetEdgeIdToGraphData();
+		// The compact graph charges the wait on the bus edge, it's put back as a separate item
+		const bool has_wait_edges = transport_graph_->GetModel() == GraphModel::WAIT_VERTICES;
+		const auto& edge_id_to_graph_data = transport_graph_->GetEdgeIdToGraphData();
+		output_data.route.reserve((*route).edges.size() * (has_wait_edges ? 1 : 2));
 		for (graph::EdgeId id : (*route).edges) {
-			output_data.route.push_back(edge_id_to_graph_data.at(id));
+			const TransportGraphData& data = edge_id_to_graph_data[id];
+			if (!has_wait_edges) {
+				output_data.route.push_back(TransportGraphData{ data.stop_from, data.stop_from, nullptr, 0, transport_graph_->GetWaitTime() });
+			}
+			output_data.route.push_back(data);
 		}
 		return output_data;
 	}
 	return std::nullopt;
-}
\ No newline at end of file
+}
+
+std::vector<std::pair<const domain::Stop*, TransportTime>> TransportRouter::GetReachableStops(const domain::Stop* from,
+	TransportTime max_time) const {
+	std::vector<std::pair<const domain::Stop*, TransportTime>> stops;
+	if (line_router_) {
+		stops = line_router_->GetReachableStops(from, max_time);
+	}
+	else if (const VertexIdLoop* from_vertex_id = transport_graph_->FindVertexId(from); from_vertex_id == nullptr) {
+		if (max_time >= TransportTime{}) {
+			stops.push_back({ from, TransportTime{} });
+		}
+	}
+	else {
+		const auto holder = search_workspaces_.Acquire(transport_graph_->GetGraph().GetVertexCount());
+		const auto settled = graph::detail::ComputeWeightsWithin(transport_graph_->GetGraph(), *holder,
+			from_vertex_id->transfer_id, max_time);
+		for (const auto& [vertex, time] : settled) {
+			if (const domain::Stop* stop = transport_graph_->GetStopByTransferVertex(vertex)) {
+				stops.push_back({ stop, time });
+			}
+		}
+	}
+
+	// Equal times in name order, so the answer doesn't depend on the engine
+	std::stable_sort(stops.begin(), stops.end(), [](const auto& lhs, const auto& rhs) {
+		return std::tie(lhs.second, lhs.first->name_) < std::tie(rhs.second, rhs.first->name_);
+	});
+	return stops;
+}
+
+std::vector<std::vector<std::optional<TransportTime>>> TransportRouter::GetTravelTimes(const std::vector<const domain::Stop*>& origins,
+	const std::vector<const domain::Stop*>& destinations) const {
+	std::vector<std::vector<std::optional<TransportTime>>> times(origins.size());
+	if (line_router_) {
+		parallel::ForEachIndex(origins.size(), parallel::GetDefaultThreadCount(), [&](size_t i) {
+			times[i] = line_router_->GetTravelTimes(origins[i], destinations);
+		});
+		return times;
+	}
+
+	// Stops without a vertex (served by no bus) are left out of the searches and filled in afterwards
+	std::vector<graph::VertexId> targets;
+	std::vector<size_t> target_columns;
+	targets.reserve(destinations.size());
+	for (size_t column = 0; column < destinations.size(); ++column) {
+		if (const VertexIdLoop* vertex_id = transport_graph_->FindVertexId(destinations[column])) {
+			targets.push_back(vertex_id->transfer_id);
+			target_columns.push_back(column);
+		}
+	}
+
+	parallel::ForEachIndex(origins.size(), parallel::GetDefaultThreadCount(), [&](size_t i) {
+		times[i].assign(destinations.size(), std::nullopt);
+		if (const VertexIdLoop* from_vertex_id = transport_graph_->FindVertexId(origins[i])) {
+			const auto weights = router_->GetRouteWeights(from_vertex_id->transfer_id, targets);
+			for (size_t j = 0; j < weights.size(); ++j) {
+				times[i][target_columns[j]] = weights[j];
+			}
+			return;
+		}
+		for (size_t column = 0; column < destinations.size(); ++column) {
+			if (destinations[column] == origins[i]) {
+				times[i][column] = TransportTime{};
+			}
+		}
+	});
+	return times;
+}
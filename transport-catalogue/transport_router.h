@@ -1,19 +1,82 @@
 #pragma once
 
-#include <unordered_map>
-
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "alt_router.h"
+#include "bidirectional_dijkstra_router.h"
+#include "contraction_hierarchies.h"
+#include "dijkstra_router.h"
 #include "domain.h"
 #include "graph.h"
+#include "hub_labels_router.h"
+#include "lru_cache.h"
 #include "router.h"
+#include "source_trees_router.h"
 #include "transport_catalogue.h"
 
 namespace transport_graph {
 
 	using namespace transport_catalogue;
 
+#ifdef TRANSPORT_INTEGRAL_TIME
+	// Centiseconds: sums and comparisons are exact and integral, all-pairs cells take 4 bytes.
+	// Signed, since the line model subtracts times.
+	using TransportTime = int32_t;
+	static constexpr double TIME_UNITS_PER_MINUTE = 6000.0;
+#else
+	// Minutes
 	using TransportTime = double;
+	static constexpr double TIME_UNITS_PER_MINUTE = 1.0;
+#endif
 	static constexpr double TO_MINUTES = (3.6 / 60.0);
 
+	// Between minutes, as the input and the output count them, and routing time units
+	inline TransportTime ToTransportTime(double minutes) {
+		if constexpr (std::is_integral_v<TransportTime>) {
+			// Budgets past the range mean "no limit"
+			const double units = std::min(minutes * TIME_UNITS_PER_MINUTE, static_cast<double>(std::numeric_limits<TransportTime>::max()));
+			return static_cast<TransportTime>(std::llround(units));
+		}
+		else {
+			return static_cast<TransportTime>(minutes * TIME_UNITS_PER_MINUTE);
+		}
+	}
+
+	inline double ToMinutes(TransportTime time) {
+		return time / TIME_UNITS_PER_MINUTE;
+	}
+
+	enum class RouterType {
+		ALL_PAIRS,
+		DIJKSTRA,
+		CONTRACTION_HIERARCHIES,
+		BIDIRECTIONAL_DIJKSTRA,
+		// A* with landmark bounds, landmarks picked at the geographic edge of the network
+		ALT,
+		HUB_LABELS,
+		// Shortest path trees from the origins of a known batch of requests, see SourceTreesRouter
+		SOURCE_TREES,
+		// Not a graph engine: routes over the bus lines of the catalogue, see LineRouter
+		BUS_LINES
+	};
+
+	// How stops become vertices; routes are the same in both
+	enum class GraphModel {
+		// Two vertices per stop: routes start and end at `transfer_id`, and the wait is charged on the
+		// edge to `id`, where bus edges leave from
+		WAIT_VERTICES,
+		// One vertex per stop served by a bus (`id` == `transfer_id`), the wait charged on every bus edge.
+		// A quarter of the cells and an eighth of the work for the all-pairs engine.
+		COMPACT
+	};
+
 	struct VertexIdLoop {
 		graph::VertexId id;
 		graph::VertexId transfer_id;
@@ -24,49 +87,141 @@ namespace transport_graph {
 		const domain::Stop* stop_to;
 		const domain::Bus* bus;
 		int stop_count;
-		double time;
+		TransportTime time;
 	};
 
-	using EdgesData = std::unordered_map<graph::VertexId, std::unordered_map<graph::VertexId, TransportGraphData>>;
+	// Bus edge candidate before duplicates between the same pair of vertices are dropped
+	struct BusEdge {
+		graph::VertexId from;
+		graph::VertexId to;
+		TransportGraphData data;
+	};
 
+	using BusEdges = std::vector<BusEdge>;
+
+	// Immutable once built: routers and worker threads share one instance through
+	// std::shared_ptr<const TransportGraph> rather than copying it
 	class TransportGraph {
 	public:
-		explicit TransportGraph(const TransportCatalogue& catalogue) 
-			:graph_(catalogue.GetStops().size() * 2) {
-			SetVertex(catalogue);
-			CreateDiagonalEdges(catalogue);
-			CreateGraph(catalogue);	
+		static constexpr graph::VertexId NO_VERTEX = std::numeric_limits<graph::VertexId>::max();
+
+		// The catalogue must outlive the graph
+		explicit TransportGraph(const TransportCatalogue& catalogue, GraphModel model = GraphModel::COMPACT)
+			:catalogue_(catalogue), model_(model), wait_time_(ToTransportTime(catalogue.GetRoutingSettings().bus_wait_time)) {
+			SetVertex();
+			IndexTransferVertices();
+			if (model_ == GraphModel::WAIT_VERTICES) {
+				CreateDiagonalEdges();
+			}
+			CreateGraph();	
+			graph_.Freeze();
+		}
+
+		// Restores a graph built earlier over `catalogue`, e.g. loaded from saved routes
+		TransportGraph(const TransportCatalogue& catalogue, graph::DirectedWeightedGraph<TransportTime> graph,
+			std::vector<TransportGraphData> edge_id_to_graph_data, std::vector<VertexIdLoop> stop_vertex_ids, GraphModel model)
+			:catalogue_(catalogue), model_(model), wait_time_(ToTransportTime(catalogue.GetRoutingSettings().bus_wait_time))
+			, edge_id_to_graph_data_(std::move(edge_id_to_graph_data)), stop_vertex_ids_(std::move(stop_vertex_ids)), graph_(std::move(graph)) {
+			if (!graph_.IsFrozen()) {
+				graph_.Freeze();
+			}
+			IndexTransferVertices();
 		}
 
+		// Copy of `previous` after its catalogue changed, where only road distances may change and buses
+		// may be added (no new stops in the catalogue). Only the edges between stops of `changed_buses` are recomputed: their weights
+		// are patched in place and new stop pairs get new edges at the end, so EdgeIds of `previous` stay
+		// valid. GetChangedEdges lists the edges whose weight differs from `previous`. In the compact
+		// model stops a new bus serves for the first time get vertices after those of `previous`.
+		TransportGraph(const TransportGraph& previous, const std::vector<domain::Bus*>& changed_buses);
+
+		TransportGraph(const TransportGraph&) = delete;
+		TransportGraph& operator=(const TransportGraph&) = delete;
+
 		const graph::DirectedWeightedGraph<TransportTime>& GetGraph() const {
 			return graph_;
 		}
 
-		const std::unordered_map<graph::EdgeId, TransportGraphData>& GetEdgeIdToGraphData() const {
+		// Approximate bytes held by the graph and its edge and stop metadata
+		size_t GetMemoryUsage() const;
+
+		// Indexed by EdgeId
+		const std::vector<TransportGraphData>& GetEdgeIdToGraphData() const {
 			return edge_id_to_graph_data_;
 		}
 
-		const std::unordered_map<const domain::Stop*, VertexIdLoop>& GetStopToVertexId() const {
-			return stop_to_vertex_id_;
+		const TransportCatalogue& GetCatalogue() const {
+			return catalogue_;
+		}
+
+		// Indexed by StopId. Stops no bus serves have no vertices in the compact model: both ids are
+		// NO_VERTEX.
+		const std::vector<VertexIdLoop>& GetStopVertexIds() const {
+			return stop_vertex_ids_;
+		}
+
+		// nullptr for a stop without vertices
+		const VertexIdLoop* FindVertexId(const domain::Stop* stop) const {
+			const VertexIdLoop& vertex_id = stop_vertex_ids_.at(stop->id_);
+			return vertex_id.id == NO_VERTEX ? nullptr : &vertex_id;
+		}
+
+		GraphModel GetModel() const {
+			return model_;
+		}
+
+		TransportTime GetWaitTime() const {
+			return wait_time_;
+		}
+
+		// Stop whose routes start and end at `vertex`, nullptr for the other vertices
+		const domain::Stop* GetStopByTransferVertex(graph::VertexId vertex) const {
+			return transfer_vertex_to_stop_[vertex];
+		}
+
+		// Empty unless the graph was updated from another one
+		const std::vector<graph::EdgeId>& GetChangedEdges() const {
+			return changed_edges_;
 		}
 
 	private:
 
-		void SetVertex(const TransportCatalogue& catalogue);
-		void CreateDiagonalEdges(const TransportCatalogue& catalogue);
-		void CreateGraph(const TransportCatalogue& catalogue);
+		void SetVertex();
+		void IndexTransferVertices();
+		void CreateDiagonalEdges();
+		void CreateGraph();
+
+		static size_t CountBusEdges(const domain::Bus* bus);
+
+		// Writes the edges of both directions of a bus, CountBusEdges of them
+		BusEdge* CreateBusEdges(const domain::Bus* bus, BusEdge* out) const;
 
+		// Writes the edges of one direction of a bus starting at `out`, returns the end of them
 		template <typename It>
-		std::vector<TransportGraphData> CreateTransportGraphData(const ranges::BusRange<It>& bus_range, const TransportCatalogue& catalogue);
+		BusEdge* CreateTransportGraphData(const ranges::BusRange<It>& bus_range, BusEdge* out) const;
 
-		void CreateEdges(EdgesData& edges, std::vector<TransportGraphData>&& data);
-		void AddEdgesToGraph(EdgesData& edges);
+		void AddEdgesToGraph(BusEdges& edges);
 
-		std::unordered_map<graph::EdgeId, TransportGraphData> edge_id_to_graph_data_{};
-		std::unordered_map<const domain::Stop*, VertexIdLoop> stop_to_vertex_id_{};
+		// The bus ride, plus the wait before it in the compact model
+		TransportTime GetEdgeWeight(const TransportGraphData& data) const {
+			return model_ == GraphModel::COMPACT && data.bus != nullptr ? wait_time_ + data.time : data.time;
+		}
+
+		// Recomputes the edges of the stop pairs served by `changed_buses`, see the updating constructor
+		void UpdateBusEdges(const graph::DirectedWeightedGraph<TransportTime>& previous_graph, const std::vector<domain::Bus*>& changed_buses);
+
+		const TransportCatalogue& catalogue_;
+		GraphModel model_;
+		TransportTime wait_time_;
+		std::vector<TransportGraphData> edge_id_to_graph_data_{};
+		std::vector<VertexIdLoop> stop_vertex_ids_{};
+		std::vector<const domain::Stop*> transfer_vertex_to_stop_{};
 		graph::DirectedWeightedGraph<TransportTime> graph_{};
+		std::vector<graph::EdgeId> changed_edges_{};
 	};
 
+	class LineRouter;
+
 	class TransportRouter {
 	public:
 
@@ -75,45 +230,115 @@ namespace transport_graph {
 			TransportTime time{};
 		};
 
-		TransportRouter(const TransportGraph& graph) :transport_graph_(graph), router_(graph.GetGraph())
-		{}
+		static constexpr size_t DEFAULT_ROUTE_CACHE_BYTES = size_t{ 16 } << 20;
 
+		// The engine is built over `graph->GetGraph()`; the router keeps the snapshot alive
+		TransportRouter(std::shared_ptr<const TransportGraph> graph, RouterType type = RouterType::ALL_PAIRS,
+			size_t route_cache_bytes = DEFAULT_ROUTE_CACHE_BYTES);
+
+		// Uses a ready engine of the given type built over `graph->GetGraph()`
+		TransportRouter(std::shared_ptr<const TransportGraph> graph, RouterType type, std::unique_ptr<graph::RouterBase<TransportTime>> router,
+			size_t route_cache_bytes = DEFAULT_ROUTE_CACHE_BYTES);
+
+		// Line-based model (RouterType::BUS_LINES) straight over the catalogue, no TransportGraph needed
+		explicit TransportRouter(const TransportCatalogue& catalogue, size_t route_cache_bytes = DEFAULT_ROUTE_CACHE_BYTES);
+
+		~TransportRouter();
+
+		// Finished results, unreachable pairs included, are cached per (from, to) within the byte budget
 		std::optional<TransportRouter::TransportRouterData> GetRoute(const domain::Stop* from, const domain::Stop* to) const;
 
+		// Stops reachable from `from` within `max_time`, with their travel times, fastest first (`from`
+		// itself included). One search bounded by the budget; no routes are built.
+		std::vector<std::pair<const domain::Stop*, TransportTime>> GetReachableStops(const domain::Stop* from, TransportTime max_time) const;
+
+		// Travel times from every origin to every destination, rows in the order of `origins`
+		// (nullopt where unreachable). Origins are spread across worker threads; each row is a table
+		// lookup for the all-pairs engine and a single-source search otherwise.
+		std::vector<std::vector<std::optional<TransportTime>>> GetTravelTimes(const std::vector<const domain::Stop*>& origins,
+			const std::vector<const domain::Stop*>& destinations) const;
+
+		cache::CacheStats GetRouteCacheStats() const {
+			return route_cache_.GetStats();
+		}
+
+		// Must be called whenever the graph the engine was built over changes
+		void ClearRouteCache() {
+			route_cache_.Clear();
+		}
+
+		// Router of the same type over `graph`, which must have been updated from this router's graph
+		// (see the updating TransportGraph constructor). The all-pairs tables are repaired for the changed
+		// edges instead of being recomputed; source trees are regrown from the same sources; other engines
+		// are rebuilt. The route cache starts empty.
+		std::unique_ptr<TransportRouter> Update(std::shared_ptr<const TransportGraph> graph) const;
+
 	private:
-		TransportGraph transport_graph_;
-		graph::Router<TransportTime> router_;
+		using StopPair = std::pair<const domain::Stop*, const domain::Stop*>;
+
+		struct StopPairHasher {
+			size_t operator()(const StopPair& stops) const {
+				return std::hash<const void*>{}(stops.first) * 37 + std::hash<const void*>{}(stops.second);
+			}
+		};
+
+		static std::unique_ptr<graph::RouterBase<TransportTime>> CreateRouter(const TransportGraph& transport_graph, RouterType type);
+
+		std::optional<TransportRouterData> BuildRoute(const domain::Stop* from, const domain::Stop* to) const;
+
+		RouterType type_;
+		std::shared_ptr<const TransportGraph> transport_graph_;
+		std::unique_ptr<graph::RouterBase<TransportTime>> router_;
+		std::unique_ptr<LineRouter> line_router_;
+		graph::detail::WorkspacePool<graph::detail::SearchState<TransportTime>> search_workspaces_;
+		mutable cache::LruCache<StopPair, std::optional<TransportRouterData>, StopPairHasher> route_cache_;
 	};
 
 	template <typename It>
-	inline std::vector<TransportGraphData> TransportGraph::CreateTransportGraphData(const ranges::BusRange<It>& bus_range, const TransportCatalogue& catalogue) {
-
-		const double bus_velocity = catalogue.GetRoutingSettings().bus_velocity;
+	inline BusEdge* TransportGraph::CreateTransportGraphData(const ranges::BusRange<It>& bus_range, BusEdge* out) const {
+
+		const double bus_velocity = catalogue_.GetRoutingSettings().bus_velocity;
+
+		const std::vector<domain::StopId> stop_ids(bus_range.begin(), bus_range.end());
+		std::vector<const domain::Stop*> stops;
+		std::vector<VertexIdLoop> vertex_ids;
+		stops.reserve(stop_ids.size());
+		vertex_ids.reserve(stop_ids.size());
+		for (const domain::StopId stop_id : stop_ids) {
+			stops.push_back(catalogue_.GetStop(stop_id));
+			vertex_ids.push_back(stop_vertex_ids_[stop_id]);
+		}
 
-		std::vector<TransportGraphData> data;
+		// Distance from the previous stop, looked up once per segment rather than once per edge,
+		// and only for the segments the edges below actually use
+		std::vector<std::optional<double>> segment_distances(stops.size());
+		const auto get_segment_distance = [&](size_t to) {
+			if (!segment_distances[to]) {
+				segment_distances[to] = catalogue_.GetDistance(stop_ids[to - 1], stop_ids[to]);
+			}
+			return *segment_distances[to];
+		};
 
-		for (auto it_from = bus_range.begin(); it_from != bus_range.end(); ++it_from) {
-			const domain::Stop* stop_from = *it_from;
-			const domain::Stop* previous_stop = stop_from;
+		for (size_t from = 0; from < stops.size(); ++from) {
+			const domain::Stop* stop_from = stops[from];
 
 			double full_distance = 0.0;
 			int stop_count = 0;
 
-			for (auto it_to = it_from + 1; it_to != bus_range.end(); ++it_to) {
-				const domain::Stop* stop_to = *it_to;
+			for (size_t to = from + 1; to < stops.size(); ++to) {
+				const domain::Stop* stop_to = stops[to];
 
 				if (stop_from != stop_to) {
-					full_distance += catalogue.GetDistance(previous_stop->name_, stop_to->name_ );
+					full_distance += get_segment_distance(to);
 					stop_count++;
 
-					data.push_back({ stop_from, stop_to, bus_range.GetPtr(), stop_count, (full_distance / bus_velocity) * TO_MINUTES });
+					*out++ = BusEdge{ vertex_ids[from].id, vertex_ids[to].transfer_id,
+						{ stop_from, stop_to, bus_range.GetPtr(), stop_count, ToTransportTime((full_distance / bus_velocity) * TO_MINUTES) } };
 				}
-
-				previous_stop = stop_to;
 			}
 		}
 
-		return data;
+		return out;
 	}
 
 }
\ No newline at end of file